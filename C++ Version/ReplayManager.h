@@ -1,47 +1,96 @@
 #pragma once
-#include <queue>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
 #include "SaveManager.h"  // For PlayerState
 
+// Replay-only input bits, alongside the movement bits in InputBits.
+enum ReplayBits : uint8_t {
+    REPLAY_SAVE = 0x40,
+    REPLAY_UNDO = 0x80,
+};
+
+// Frames between keyframes; a seek re-simulates at most this many.
+const size_t REPLAY_KEYFRAME_INTERVAL = 64;
+
 class ReplayManager {
 private:
-    std::queue<PlayerState> replayQueue;
+    // Player and save state at the start of `frame`.
+    struct Keyframe {
+        size_t frame;
+        PlayerState state;
+        SaveManager saves;
+    };
+
+    // One input mask per frame since the level started, plus a keyframe
+    // every REPLAY_KEYFRAME_INTERVAL frames. Playback re-runs the physics
+    // from a keyframe instead of storing positions.
+    std::vector<uint8_t> frames;
+    std::vector<Keyframe> keyframes;
+    size_t replayPos = 0;
 
     bool replaying = false;
 
 public:
-    // Record player moves during gameplay
-    void recordMove(const PlayerState& state) {
-        if (!replaying) replayQueue.push(state);
+    // Start recording a new level from `state`
+    void begin(const PlayerState& state) {
+        clear();
+        keyframes.push_back({0, state, SaveManager()});
+    }
+
+    // Record the inputs applied this frame, and the state and saves left
+    // after it
+    void recordFrame(uint8_t inputs, const PlayerState& after, const SaveManager& saves) {
+        if (replaying) return;
+        frames.push_back(inputs);
+        if (frames.size() % REPLAY_KEYFRAME_INTERVAL == 0)
+            keyframes.push_back({frames.size(), after, saves});
     }
 
-    // Start replay
-    void startReplay() {
-        replaying = true;
+    // Start replay; returns the state and saves to re-simulate from
+    void startReplay(PlayerState& state, SaveManager& saves) {
+        replaying = !frames.empty();
+        seekKeyframe(0, state, saves);
     }
-    
+
     // Stop replay
     void stopReplay() {
         replaying = false;
     }
-    
+
     // Check if replay is active
     bool isReplaying() const {
         return replaying;
     }
-    
-    // Get next move in replay
-    bool getNext(PlayerState& state) {
-        if (!replaying || replayQueue.empty()) return false;
-        state = replayQueue.front();
-        replayQueue.pop();
-        if (replayQueue.empty()) replaying = false;
+
+    size_t position() const { return replayPos; }
+    size_t length() const { return frames.size(); }
+
+    // Rewind to the last keyframe at or before `frame`; the caller then
+    // re-simulates with getNext() until position() reaches `frame`
+    void seekKeyframe(size_t frame, PlayerState& state, SaveManager& saves) {
+        if (keyframes.empty()) return;
+        auto k = std::upper_bound(keyframes.begin(), keyframes.end(), frame,
+            [](size_t f, const Keyframe& key) { return f < key.frame; });
+        --k;
+        replayPos = k->frame;
+        state = k->state;
+        saves = k->saves;
+    }
+
+    // Get the inputs of the next frame in replay
+    bool getNext(uint8_t& inputs) {
+        if (!replaying || replayPos >= frames.size()) return false;
+        inputs = frames[replayPos++];
+        if (replayPos >= frames.size()) replaying = false;
         return true;
     }
 
     // Clear all recorded moves
     void clear() {
-        std::queue<PlayerState> empty;
-        std::swap(replayQueue, empty);
+        std::vector<uint8_t>().swap(frames);
+        std::vector<Keyframe>().swap(keyframes);
+        replayPos = 0;
         replaying = false;
     }
 };
@@ -1,18 +1,25 @@
 #pragma once
-#include <stack>
+#include <cstddef>
+#include "RingStack.h"
+#include "Scalar.h"
 
 // Struct to store entire player state
 struct PlayerState {
     int x, y;
-    double vy;
+    Scalar vy;
     bool grounded;
 };
 
+// Saves kept for undo; the oldest is overwritten past this.
+const size_t SAVE_DEPTH = 16;
+
 class SaveManager {
 private:
-    std::stack<PlayerState> savedStates;
+    RingStack<PlayerState> savedStates;
 
 public:
+    explicit SaveManager(size_t depth = SAVE_DEPTH) : savedStates(depth) {}
+
     // Save the current player state
     void saveState(const PlayerState& state) {
         savedStates.push(state);
@@ -31,8 +38,13 @@ public:
         return !savedStates.empty();
     }
 
+    // Number of saves overwritten because the history was full
+    unsigned long long droppedStates() const {
+        return savedStates.dropped();
+    }
+
     // Clear all saved states
     void clear() {
-        while (!savedStates.empty()) savedStates.pop();
+        savedStates.clear();
     }
 };
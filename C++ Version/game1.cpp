@@ -2,68 +2,14 @@
 #include <vector>
 #include <conio.h>
 #include <windows.h>
-#include <cmath>
+#include "World.h"
+#include "LevelFile.h"
+#include "Camera.h"
 #include "SaveManager.h"
 #include "ReplayManager.h"
 
 using namespace std;
 
-// ---------------------------------------------------------
-// PLAYER STRUCT
-// ---------------------------------------------------------
-struct Player {
-    int x, y;
-    double vy;
-    bool grounded;
-};
-
-// ---------------------------------------------------------
-// LEVEL CLASS
-// ---------------------------------------------------------
-class Level {
-private:
-    int width, height;
-    vector<vector<char>> grid;
-
-public:
-    int goalX, goalY;
-
-    Level(int w, int h) : width(w), height(h) {
-        grid = vector<vector<char>>(height, vector<char>(width, ' '));
-    }
-
-    void createPlatform(int y, int startX, int length) {
-        for (int x = startX; x < startX + length && x < width; x++)
-            grid[y][x] = '#';
-    }
-
-    void createFullGround() {
-        for (int x = 0; x < width; x++)
-            grid[height - 1][x] = '#';
-    }
-
-    void createWalls() {
-        for (int y = 0; y < height; y++) {
-            grid[y][0] = '#';
-            grid[y][width - 1] = '#';
-        }
-    }
-
-    void setGoal(int x, int y) {
-        goalX = x;
-        goalY = y;
-    }
-
-    bool isBlocked(int x, int y) {
-        if (x < 0 || x >= width || y < 0 || y >= height) return true;
-        return grid[y][x] == '#';
-    }
-
-    char getTile(int x, int y) {
-        return grid[y][x];
-    }
-};
-
 // ---------------------------------------------------------
 // GAME CLASS
 // ---------------------------------------------------------
@@ -76,12 +22,16 @@ private:
     Player player;
     SaveManager saveManager;
     ReplayManager replayManager;
+    SaveManager replaySaves;        // saves made while re-simulating a replay
+    int replaySpeed = 1;            // replay frames per game frame, 0 = paused
+    uint8_t frameInputs = INPUT_NONE;
     vector<Level*> levels;
+    vector<pair<int, int>> spawns;  // player start per level
+    Camera camera{width, height};   // levels larger than the window scroll
     int currentLevelIndex = 0;
 
-    const double GRAVITY = 0.3;
-    const double JUMP = -2.0;
-    const double MAX_FALL = 2.0;
+    // Lighter gravity than the other front-ends: jump -2.0, max fall 2.0.
+    PhysicsConfig physicsConfig{Scalar(0.3), Scalar(-2.0), Scalar(2.0)};
 
 public:
     Game() {
@@ -111,41 +61,37 @@ public:
         SetConsoleTitle("OOP Platformer Game with Replay");
     }
 
+    // Levels come from levels\<n>.lvl in number order, compiled to .lvb
+    // on first run (see Core/LevelSource.h for the format). The levels
+    // folder is looked for here, then beside game1.exe.
     void loadLevels() {
-        // LEVEL 1
-        Level* lvl1 = new Level(width, height);
-        lvl1->createFullGround();
-        lvl1->createWalls();
-        lvl1->createPlatform(14, 10, 10);
-        lvl1->createPlatform(11, 23, 12);
-        lvl1->createPlatform(8,  37, 13);
-        lvl1->createPlatform(7,  29, 4);
-        lvl1->createPlatform(5,  15, 10);
-        lvl1->createPlatform(17, 5, 5);
-        lvl1->setGoal(15, 4);
-        levels.push_back(lvl1);
-
-        // LEVEL 2
-        Level* lvl2 = new Level(width, height);
-        lvl2->createFullGround();
-        lvl2->createWalls();
-        lvl2->createPlatform(16,  8, 12);
-        lvl2->createPlatform(12, 20, 10);
-        lvl2->createPlatform(9,  32, 15);
-        lvl2->createPlatform(6,  45, 10);
-        lvl2->setGoal(50, 5);
-        levels.push_back(lvl2);
+        char exe[MAX_PATH] = "";
+        GetModuleFileNameA(nullptr, exe, MAX_PATH);
+        string dir = findLevelDir("levels", exe);
+
+        vector<string> errors;
+        for (auto& entry : loadLevelPack(dir, errors)) {
+            Level* lvl = new Level();
+            entry.second->load(*lvl);
+            levels.push_back(lvl);
+            spawns.push_back({entry.second->header().spawnX, entry.second->header().spawnY});
+        }
+        for (const string& error : errors) cout << "Warning: " << error << "\n";
+        if (levels.empty()) {
+            cout << "No levels found in " << dir << "\n";
+            exit(1);
+        }
     }
 
     void loadLevel(int index) {
         currentLevelIndex = index;
-        player.x = 5;
-        player.y = height - 2;
-        player.vy = 0;
+        player.x = spawns[index].first;
+        player.y = spawns[index].second;
+        player.vy = Scalar(0);
         player.grounded = true;
 
         saveManager.clear();
-        replayManager.clear(); // Clear replay queue on new level
+        replayManager.begin(currentState()); // Record the new level from here
         system("cls");
     }
 
@@ -153,7 +99,19 @@ public:
         return levels[currentLevelIndex];
     }
 
+    PlayerState currentState() const {
+        return {player.x, player.y, player.vy, player.grounded};
+    }
+
+    void restoreState(const PlayerState& state) {
+        player.x = state.x;
+        player.y = state.y;
+        player.vy = state.vy;
+        player.grounded = state.grounded;
+    }
+
     void input() {
+        frameInputs = INPUT_NONE;
         if (!_kbhit()) return;
         char key = _getch();
 
@@ -161,36 +119,33 @@ public:
             // Arrow keys
             if (key == -32 || key == 0) {
                 key = _getch();
-                if (key == 75) { // LEFT
-                    if (!currentLevel()->isBlocked(player.x - 1, player.y))
-                        player.x--;
-                }
-                if (key == 77) { // RIGHT
-                    if (!currentLevel()->isBlocked(player.x + 1, player.y))
-                        player.x++;
-                }
+                if (key == 75) // LEFT
+                    frameInputs |= INPUT_LEFT;
+                if (key == 77) // RIGHT
+                    frameInputs |= INPUT_RIGHT;
             }
 
-            if (key == 72 && player.grounded) { // UP arrow → jump
-                player.vy = JUMP;
-                player.grounded = false;
-            }
+            if (key == 72) // UP arrow → jump
+                frameInputs |= INPUT_JUMP;
+
+            applyInput(player, *currentLevel(), physicsConfig, frameInputs);
 
             // Save player state
             if (key == 's' || key == 'S') {
-                PlayerState state = {player.x, player.y, player.vy, player.grounded};
-                saveManager.saveState(state);
+                unsigned long long dropped = saveManager.droppedStates();
+                saveManager.saveState(currentState());
+                frameInputs |= REPLAY_SAVE;
                 cout << "\nPlayer state saved! (" << player.x << "," << player.y << ")\n";
+                if (saveManager.droppedStates() > dropped)
+                    cout << "Oldest save dropped (keeping " << SAVE_DEPTH << ").\n";
             }
 
             // Undo last saved state
             if (key == 'u' || key == 'U') {
+                frameInputs |= REPLAY_UNDO;
                 PlayerState state;
                 if (saveManager.undoState(state)) {
-                    player.x = state.x;
-                    player.y = state.y;
-                    player.vy = state.vy;
-                    player.grounded = state.grounded;
+                    restoreState(state);
                     cout << "\nReverted to last saved state: (" << player.x << "," << player.y << ")\n";
                 } else {
                     cout << "\nNo saved state to undo!\n";
@@ -199,9 +154,20 @@ public:
 
             // Start replay
             if (key == 'r' || key == 'R') {
-                replayManager.startReplay();
-                cout << "\nReplay started!\n";
+                PlayerState start;
+                replayManager.startReplay(start, replaySaves);
+                if (replayManager.isReplaying()) {
+                    restoreState(start);
+                    replaySpeed = 1;
+                    cout << "\nReplay started!\n";
+                }
             }
+        } else {
+            // Replay controls: seek back / forward two seconds, change speed
+            if (key == ',') seekReplay(replayManager.position() < 40 ? 0 : replayManager.position() - 40);
+            if (key == '.') seekReplay(replayManager.position() + 40);
+            if (key == '+' && replaySpeed < 8) replaySpeed++;
+            if (key == '-' && replaySpeed > 0) replaySpeed--;
         }
 
         if (key == 27) // ESC
@@ -209,35 +175,28 @@ public:
     }
 
     void physics() {
-        Level* lvl = currentLevel();
+        stepPhysics(player, *currentLevel(), physicsConfig);
+    }
 
-        if (!player.grounded) {
-            player.vy += GRAVITY;
-            if (player.vy > MAX_FALL) player.vy = MAX_FALL;
-        }
+    // Re-runs one recorded frame exactly as input() and physics() did live.
+    void replayFrame(uint8_t inputs) {
+        applyInput(player, *currentLevel(), physicsConfig, inputs);
+        if (inputs & REPLAY_SAVE) replaySaves.saveState(currentState());
+        PlayerState state;
+        if ((inputs & REPLAY_UNDO) && replaySaves.undoState(state)) restoreState(state);
+        physics();
+    }
 
-        if (player.vy != 0) {
-            int steps = int(fabs(player.vy) + 0.5);
-            int dir = (player.vy > 0) ? 1 : -1;
+    // Jump to `frame` of the replay: restore the nearest earlier keyframe,
+    // then re-simulate the frames in between.
+    void seekReplay(size_t frame) {
+        PlayerState state;
+        replayManager.seekKeyframe(frame, state, replaySaves);
+        restoreState(state);
 
-            for (int i = 0; i < steps; i++) {
-                int newY = player.y + dir;
-                if (lvl->isBlocked(player.x, newY)) {
-                    player.vy = 0;
-                    if (dir > 0) player.grounded = true;
-                    break;
-                } else {
-                    player.y = newY;
-                }
-            }
-        }
-
-        if (lvl->isBlocked(player.x, player.y + 1)) {
-            player.grounded = true;
-            player.vy = 0;
-        } else {
-            player.grounded = false;
-        }
+        uint8_t inputs;
+        while (replayManager.position() < frame && replayManager.getNext(inputs))
+            replayFrame(inputs);
     }
 
     void checkGoal() {
@@ -264,13 +223,15 @@ public:
         string out;
         out.reserve(8000);
 
+        camera.follow(*lvl, player.x, player.y);
+
         // Top border
-        for (int x = 0; x < width + 2; x++) out += '=';
+        for (int x = 0; x < camera.viewWidth + 2; x++) out += '=';
         out += '\n';
 
-        for (int y = 0; y < height; y++) {
+        for (int y = camera.y; y < camera.y + camera.viewHeight; y++) {
             out += '|';
-            for (int x = 0; x < width; x++) {
+            for (int x = camera.x; x < camera.x + camera.viewWidth; x++) {
                 if (x == player.x && y == player.y)
                     out += '@';
                 else if (x == lvl->goalX && y == lvl->goalY)
@@ -281,7 +242,7 @@ public:
             out += "|\n";
         }
 
-        out += " Arrow Keys = Move | Jump = UP ARROW | S = Save | U = Undo | R = Replay | ESC = EXIT";
+        out += " Arrow Keys = Move | Jump = UP ARROW | S = Save | U = Undo | R = Replay (,/. seek, +/- speed) | ESC = EXIT";
 
         DWORD written;
         WriteConsole(hConsole, out.c_str(), out.length(), &written, NULL);
@@ -292,18 +253,13 @@ public:
             input();
 
             if (replayManager.isReplaying()) {
-                PlayerState state;
-                if (replayManager.getNext(state)) {
-                    player.x = state.x;
-                    player.y = state.y;
-                    player.vy = state.vy;
-                    player.grounded = state.grounded;
-                }
+                uint8_t inputs;
+                for (int i = 0; i < replaySpeed && replayManager.getNext(inputs); i++)
+                    replayFrame(inputs);
             } else {
                 physics();
-                // Record player moves
-                PlayerState current = {player.x, player.y, player.vy, player.grounded};
-                replayManager.recordMove(current);
+                // Record this frame's inputs
+                replayManager.recordFrame(frameInputs, currentState(), saveManager);
             }
 
             render();
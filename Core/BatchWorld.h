@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Player.h"
+#include "Level.h"
+#include "Physics.h"
+#include "ThreadPool.h"
+
+// Many independent players on one shared level, for offline runs (level
+// tuning, bots). Players are stored structure-of-arrays and stepped in
+// parallel; lane i moves exactly as a World with the same level and inputs
+// would, because each lane runs the same applyInput/stepPhysics.
+//
+// The level is read by every thread during stepAll(), so it must not be
+// changed while a step is running.
+template <class Num>
+class BasicBatchWorld {
+    // Lanes per parallel chunk: big enough to amortise the hand-off, small
+    // enough to balance the load across threads.
+    static const size_t CHUNK = 4096;
+
+    std::vector<int> xs, ys;
+    std::vector<Num> vys;
+    std::vector<uint8_t> groundeds;
+    ThreadPool pool;
+
+    void stepRange(const uint8_t* inputs, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            BasicPlayer<Num> p;
+            p.x = xs[i];
+            p.y = ys[i];
+            p.vy = vys[i];
+            p.grounded = groundeds[i] != 0;
+            applyInput(p, level, config, inputs[i]);
+            stepPhysics(p, level, config);
+            xs[i] = p.x;
+            ys[i] = p.y;
+            vys[i] = p.vy;
+            groundeds[i] = p.grounded;
+        }
+    }
+
+public:
+    Level level;
+    BasicPhysicsConfig<Num> config;
+
+    // `threads` counts the calling thread; 0 means one per hardware thread.
+    BasicBatchWorld(const Level& shared, size_t count, unsigned threads = 0,
+                    BasicPhysicsConfig<Num> physics = BasicPhysicsConfig<Num>())
+        : xs(count), ys(count), vys(count), groundeds(count), pool(threads),
+          level(shared), config(physics) {
+        BasicPlayer<Num> start;
+        spawnAll(start.x, start.y);
+    }
+
+    size_t size() const { return xs.size(); }
+    unsigned threads() const { return pool.size(); }
+
+    void spawn(size_t i, int x, int y) {
+        xs[i] = x;
+        ys[i] = y;
+        vys[i] = Num(0);
+        groundeds[i] = 1;
+    }
+
+    void spawnAll(int x, int y) {
+        for (size_t i = 0; i < size(); i++) spawn(i, x, y);
+    }
+
+    BasicPlayer<Num> player(size_t i) const {
+        BasicPlayer<Num> p;
+        p.x = xs[i];
+        p.y = ys[i];
+        p.vy = vys[i];
+        p.grounded = groundeds[i] != 0;
+        return p;
+    }
+
+    // Advances every lane one tick; inputs[i] is lane i's held controls.
+    void stepAll(const uint8_t* inputs) {
+        pool.parallelFor(size(), CHUNK, [&](size_t begin, size_t end) {
+            stepRange(inputs, begin, end);
+        });
+    }
+
+    void stepAll(const std::vector<uint8_t>& inputs) {
+        stepAll(inputs.data());
+    }
+
+    bool atGoal(size_t i) const {
+        return level.isGoal(xs[i], ys[i]);
+    }
+};
+
+using BatchWorld = BasicBatchWorld<Scalar>;
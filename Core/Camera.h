@@ -0,0 +1,47 @@
+#pragma once
+#include "Level.h"
+
+// The part of a level a front-end shows: a window of up to `width` x
+// `height` cells kept around a target (the player) and clamped to the
+// level's edges, so a level larger than the screen scrolls and a smaller
+// one is shown whole.
+struct Camera {
+    int x = 0, y = 0;           // top-left cell of the view
+    int width, height;          // requested window size
+    int viewWidth = 0, viewHeight = 0;  // window size after clamping to the level
+
+    Camera(int w, int h) : width(w), height(h) {}
+
+    // Centres the view on the target.
+    void follow(const Level& level, int targetX, int targetY) {
+        fit(level);
+        x = clampAxis(targetX - viewWidth / 2, level.getWidth() - viewWidth);
+        y = clampAxis(targetY - viewHeight / 2, level.getHeight() - viewHeight);
+    }
+
+    // Leaves the view where it is while the target stays at least a quarter
+    // of the window inside it, and recentres on the target otherwise, so
+    // small moves never shift the view. Returns whether the view moved.
+    bool track(const Level& level, int targetX, int targetY) {
+        fit(level);
+        int oldX = x, oldY = y;
+        int marginX = viewWidth / 4, marginY = viewHeight / 4;
+        int newX = x, newY = y;
+        if (targetX < x + marginX || targetX >= x + viewWidth - marginX) newX = targetX - viewWidth / 2;
+        if (targetY < y + marginY || targetY >= y + viewHeight - marginY) newY = targetY - viewHeight / 2;
+        x = clampAxis(newX, level.getWidth() - viewWidth);
+        y = clampAxis(newY, level.getHeight() - viewHeight);
+        return x != oldX || y != oldY;
+    }
+
+private:
+    void fit(const Level& level) {
+        viewWidth = width < level.getWidth() ? width : level.getWidth();
+        viewHeight = height < level.getHeight() ? height : level.getHeight();
+    }
+
+    static int clampAxis(int start, int maxStart) {
+        if (start > maxStart) start = maxStart;
+        return start < 0 ? 0 : start;
+    }
+};
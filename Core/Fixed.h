@@ -0,0 +1,69 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Signed fixed-point number with FracBits fractional bits stored in 32 bits.
+// Arithmetic is plain integer math, so results are bit-identical on every
+// compiler, optimization level and CPU, unlike double.
+template <int FracBits>
+class Fixed {
+    int32_t raw_ = 0;
+
+    struct RawTag {};
+    constexpr Fixed(int32_t raw, RawTag) : raw_(raw) {}
+
+public:
+    static constexpr int32_t ONE = int32_t(1) << FracBits;
+
+    constexpr Fixed() = default;
+
+    // Conversion from a literal; rounds to the nearest representable value.
+    // Only meant for constants; simulation code never goes through double.
+    constexpr explicit Fixed(double v)
+        : raw_(int32_t(v >= 0 ? v * ONE + 0.5 : v * ONE - 0.5)) {}
+
+    static constexpr Fixed fromRaw(int32_t raw) { return Fixed(raw, RawTag()); }
+    constexpr int32_t raw() const { return raw_; }
+    constexpr double toDouble() const { return double(raw_) / ONE; }
+
+    constexpr Fixed operator-() const { return fromRaw(-raw_); }
+    constexpr Fixed operator+(Fixed o) const { return fromRaw(raw_ + o.raw_); }
+    constexpr Fixed operator-(Fixed o) const { return fromRaw(raw_ - o.raw_); }
+    constexpr Fixed operator*(Fixed o) const { return fromRaw(int32_t((int64_t(raw_) * o.raw_) >> FracBits)); }
+    constexpr Fixed operator/(Fixed o) const { return fromRaw(int32_t((int64_t(raw_) << FracBits) / o.raw_)); }
+    Fixed& operator+=(Fixed o) { raw_ += o.raw_; return *this; }
+    Fixed& operator-=(Fixed o) { raw_ -= o.raw_; return *this; }
+
+    constexpr bool operator==(Fixed o) const { return raw_ == o.raw_; }
+    constexpr bool operator!=(Fixed o) const { return raw_ != o.raw_; }
+    constexpr bool operator<(Fixed o) const { return raw_ < o.raw_; }
+    constexpr bool operator>(Fixed o) const { return raw_ > o.raw_; }
+    constexpr bool operator<=(Fixed o) const { return raw_ <= o.raw_; }
+    constexpr bool operator>=(Fixed o) const { return raw_ >= o.raw_; }
+};
+
+// Q16.16: plenty of range for velocities and sub-cell precision of 1/65536.
+using Fixed16 = Fixed<16>;
+
+// Numeric helpers the physics uses, overloaded for double and Fixed.
+inline int roundAbs(double v) { return int(std::abs(v) + 0.5); }
+inline double toDouble(double v) { return v; }
+inline uint64_t rawBits(double v) {
+    uint64_t bits = 0;
+    static_assert(sizeof(bits) == sizeof(v), "double must be 64-bit");
+    std::memcpy(&bits, &v, sizeof(v));
+    return bits;
+}
+
+template <int F>
+int roundAbs(Fixed<F> v) {
+    int32_t r = v.raw() < 0 ? -v.raw() : v.raw();
+    return int((r + (Fixed<F>::ONE >> 1)) >> F);
+}
+
+template <int F>
+double toDouble(Fixed<F> v) { return v.toDouble(); }
+
+template <int F>
+uint64_t rawBits(Fixed<F> v) { return uint64_t(uint32_t(v.raw())); }
@@ -0,0 +1,466 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+enum class EntityType : uint8_t {
+    Door,
+    Goal,
+};
+
+// Anything the player can interact with. Each cell holds at most one.
+struct Entity {
+    EntityType type;
+    int x, y;
+    bool active;
+};
+
+// Cells name their entity by a 16-bit index, 0 meaning none.
+const size_t MAX_LEVEL_ENTITIES = UINT16_MAX - 1;
+
+// Copying a Level is cheap: copies share their tile bands and entity table
+// and each copies only the parts it writes to afterwards. That makes a
+// Level usable as an undo snapshot of the whole map.
+//
+// Bands can also be read in place from a mapped level file (see mapRows and
+// LevelFile.h). The OS then pages rows in as they are first touched and
+// drops them again under memory pressure, so a large world costs memory in
+// proportion to the part actually visited, not to its size.
+class Level {
+private:
+    // Padded rows per band; a band is the unit of copy-on-write.
+    static const int BAND_SHIFT = 4;
+    static const int BAND_ROWS = 1 << BAND_SHIFT;
+    static_assert(BAND_ROWS <= 16, "a band's column of solidity bits is one uint16_t");
+
+    // Tiles and solidity both carry a one-cell solid border, so lookups one
+    // step outside the level (all the physics ever does) need no bounds
+    // checks. Cell (x, y) lives at padded position (x + 1, y + 1).
+    //
+    // Reads go through the row pointers, which point either at the band's
+    // own buffers or into a mapped file the band keeps alive. Only bands
+    // with their own buffers are ever written; copying a band gives it its
+    // own.
+    struct Band {
+        const char* tiles = nullptr;            // BAND_ROWS * paddedWidth
+        // One bit per padded cell; each padded row starts on a fresh word.
+        const uint64_t* solid = nullptr;        // BAND_ROWS * maskStride
+        // Index into `entities` plus one (0 = empty), so entity lookups
+        // are a single load.
+        const uint16_t* entityIndex = nullptr;  // BAND_ROWS * paddedWidth
+        // The same solidity bits by column, bit r for the band's row r, so
+        // vertical sweeps scan a band per load.
+        const uint16_t* columns = nullptr;      // paddedWidth
+        size_t cells = 0, words = 0;
+
+        std::vector<char> ownTiles;
+        std::vector<uint64_t> ownSolid;
+        std::vector<uint16_t> ownEntityIndex;
+        std::vector<uint16_t> ownColumns;
+        std::shared_ptr<const void> mapping;    // owner of mapped rows, if any
+
+        Band() = default;
+
+        Band(size_t cellCount, size_t wordCount) : cells(cellCount), words(wordCount) {
+            clear();
+        }
+
+        Band(const Band& other)
+            : cells(other.cells), words(other.words),
+              ownTiles(other.tiles, other.tiles + other.cells),
+              ownSolid(other.solid, other.solid + other.words),
+              ownEntityIndex(other.entityIndex, other.entityIndex + other.cells),
+              ownColumns(other.columns, other.columns + other.cells / BAND_ROWS) {
+            point();
+        }
+
+        Band& operator=(const Band&) = delete;
+
+        void clear() {
+            ownTiles.assign(cells, ' ');
+            ownSolid.assign(words, 0);
+            ownEntityIndex.assign(cells, 0);
+            ownColumns.assign(cells / BAND_ROWS, 0);
+            point();
+        }
+
+        void point() {
+            tiles = ownTiles.data();
+            solid = ownSolid.data();
+            entityIndex = ownEntityIndex.data();
+            columns = ownColumns.data();
+        }
+    };
+
+    struct Storage {
+        std::vector<std::shared_ptr<Band>> bands;
+        std::shared_ptr<std::vector<Entity>> entities;
+        uint64_t revision = 0;
+    };
+
+    int width = 0, height = 0;
+    int paddedWidth = 2;
+    int maskStride = 1;             // 64-bit words per padded row
+    std::shared_ptr<Storage> root;
+
+    static uint64_t nextRevision() {
+        static std::atomic<uint64_t> counter{0};
+        return ++counter;
+    }
+
+    const Band& band(int py) const {
+        return *root->bands[py >> BAND_SHIFT];
+    }
+
+    // Every write goes through here: anything still shared with another
+    // copy is cloned first, so other copies never see the change.
+    Storage& writableStorage() {
+        if (root.use_count() > 1) root = std::make_shared<Storage>(*root);
+        root->revision = nextRevision();
+        return *root;
+    }
+
+    Band& writableBand(int py) {
+        std::shared_ptr<Band>& b = writableStorage().bands[py >> BAND_SHIFT];
+        if (b.use_count() > 1 || b->mapping) b = std::make_shared<Band>(*b);
+        return *b;
+    }
+
+    size_t bandCells() const { return (size_t)BAND_ROWS * paddedWidth; }
+    size_t bandWords() const { return (size_t)BAND_ROWS * maskStride; }
+
+    std::vector<Entity>& writableEntities() {
+        std::shared_ptr<std::vector<Entity>>& e = writableStorage().entities;
+        if (e.use_count() > 1) e = std::make_shared<std::vector<Entity>>(*e);
+        return *e;
+    }
+
+    // Offset of padded cell (px, py) within its band's tile row storage.
+    size_t cellIndex(int px, int py) const {
+        return (size_t)(py & (BAND_ROWS - 1)) * paddedWidth + px;
+    }
+
+    size_t tileIndex(int x, int y) const {
+        assert(x >= -1 && x <= width && y >= -1 && y <= height);
+        return cellIndex(x + 1, y + 1);
+    }
+
+    size_t maskIndex(int px, int py) const {
+        return (size_t)(py & (BAND_ROWS - 1)) * maskStride + px / 64;
+    }
+
+    void setBlock(int x, int y) {
+        Band& b = writableBand(y + 1);
+        b.ownTiles[tileIndex(x, y)] = '#';
+        int px = x + 1, py = y + 1;
+        b.ownSolid[maskIndex(px, py)] |= 1ULL << (px % 64);
+        b.ownColumns[px] |= (uint16_t)(1u << (py & (BAND_ROWS - 1)));
+    }
+
+    static int lowestBit(uint64_t v) {
+#ifdef _MSC_VER
+        unsigned long i;
+        _BitScanForward64(&i, v);
+        return (int)i;
+#else
+        return __builtin_ctzll(v);
+#endif
+    }
+
+    static int highestBit(uint64_t v) {
+#ifdef _MSC_VER
+        unsigned long i;
+        _BitScanReverse64(&i, v);
+        return (int)i;
+#else
+        return 63 - __builtin_clzll(v);
+#endif
+    }
+
+    void setTile(int x, int y, char tile) {
+        writableBand(y + 1).ownTiles[tileIndex(x, y)] = tile;
+    }
+
+    // Sized but without storage; the public constructors fill it in.
+    Level(int w, int h, std::nullptr_t) : width(w), height(h), paddedWidth(w + 2), maskStride(maskWordsPerRow(w)) {}
+
+public:
+    int goalX = -1, goalY = -1;
+
+    // An empty placeholder with no storage; assign a real level before use.
+    Level() = default;
+
+    Level(int w, int h) : Level(w, h, nullptr) {
+        resetGrid();
+    }
+
+    // 64-bit solidity words per padded row of a level `w` cells wide.
+    static int maskWordsPerRow(int w) { return (w + 2 + 63) / 64; }
+
+    // Padded rows stored for a level `h` cells high: the border rows plus
+    // padding up to a whole number of bands.
+    static int storedRows(int h) { return (h + 2 + BAND_ROWS - 1) & ~(BAND_ROWS - 1); }
+
+    // Clears the level in place; buffers no other copy shares keep their
+    // allocation.
+    void resetGrid() {
+        int bandCount = storedRows(height) >> BAND_SHIFT;
+        if (!root || root.use_count() > 1) root = std::make_shared<Storage>();
+        root->revision = nextRevision();
+        root->bands.resize(bandCount);
+        for (std::shared_ptr<Band>& b : root->bands) {
+            if (!b || b.use_count() > 1 || b->mapping) b = std::make_shared<Band>(bandCells(), bandWords());
+            else b->clear();
+        }
+        if (!root->entities || root->entities.use_count() > 1)
+            root->entities = std::make_shared<std::vector<Entity>>();
+        root->entities->clear();
+
+        for (int x = -1; x <= width; x++) {
+            setBlock(x, -1);
+            setBlock(x, height);
+        }
+        for (int y = 0; y < height; y++) {
+            setBlock(-1, y);
+            setBlock(width, y);
+        }
+    }
+
+    void createPlatform(int y, int startX, int length) {
+        if (y < 0 || y >= height) return;
+        int endX = startX + length < width ? startX + length : width;
+        for (int x = startX < 0 ? 0 : startX; x < endX; x++)
+            setBlock(x, y);
+    }
+
+    void createFullGround() {
+        createPlatform(height - 1, 0, width);
+    }
+
+    void createWalls() {
+        for (int y = 0; y < height; y++) {
+            setBlock(0, y);
+            setBlock(width - 1, y);
+        }
+    }
+
+    // Empties a cell inside the level, e.g. a broken block.
+    void clearBlock(int x, int y) {
+        if (y < 0 || y >= height || x < 0 || x >= width) return;
+        Band& b = writableBand(y + 1);
+        b.ownTiles[tileIndex(x, y)] = ' ';
+        int px = x + 1, py = y + 1;
+        b.ownSolid[maskIndex(px, py)] &= ~(1ULL << (px % 64));
+        b.ownColumns[px] &= (uint16_t)~(1u << (py & (BAND_ROWS - 1)));
+    }
+
+    // Places an entity; returns false if the cell is outside the level or
+    // the level already holds MAX_LEVEL_ENTITIES.
+    bool addEntity(EntityType type, int x, int y) {
+        if (y < 0 || y >= height || x < 0 || x >= width) return false;
+        if (entities().size() >= MAX_LEVEL_ENTITIES) return false;
+        std::vector<Entity>& entities = writableEntities();
+        entities.push_back({type, x, y, true});
+        writableBand(y + 1).ownEntityIndex[tileIndex(x, y)] = (uint16_t)entities.size();
+        return true;
+    }
+
+    // Switches the entity in a cell on or off (an opened door, a used goal).
+    void setEntityActive(int x, int y, bool active) {
+        if (!entityAt(x, y)) return;
+        uint16_t index = band(y + 1).entityIndex[tileIndex(x, y)];
+        writableEntities()[index - 1].active = active;
+    }
+
+    void setGoal(int x, int y) {
+        goalX = x;
+        goalY = y;
+        if (addEntity(EntityType::Goal, x, y))
+            setTile(x, y, 'G');
+    }
+
+    void addDoor(int x, int y) {
+        if (addEntity(EntityType::Door, x, y))
+            setTile(x, y, 'D');
+    }
+
+    // Valid for -1 <= x <= width and -1 <= y <= height; the border is solid.
+    bool isBlocked(int x, int y) const {
+        assert(x >= -1 && x <= width && y >= -1 && y <= height);
+        int px = x + 1, py = y + 1;
+        return (band(py).solid[maskIndex(px, py)] >> (px % 64)) & 1;
+    }
+
+    // Where a move of `dx` cells along row y from column x ends: short of
+    // the first solid cell in the way, or at x + dx if there is none. One
+    // bit scan per 64 cells crossed, so a move of any length is cheap and
+    // never passes through a block. Same range as isBlocked for the start;
+    // the border stops any move.
+    int sweepX(int x, int y, int dx) const {
+        assert(x >= -1 && x <= width && y >= -1 && y <= height);
+        int py = y + 1;
+        const uint64_t* row = band(py).solid + maskIndex(0, py);
+        int px = x + 1;
+        if (dx > 0) {
+            int limit = px + (dx < width - x ? dx : width - x);
+            for (int p = px + 1; p <= limit; p = (p | 63) + 1) {
+                uint64_t word = row[p / 64] & (~0ULL << (p % 64));
+                if (word) {
+                    int hit = (p & ~63) + lowestBit(word);
+                    return (hit <= limit ? hit - 1 : limit) - 1;
+                }
+            }
+            return limit - 1;
+        }
+        if (dx < 0) {
+            int limit = px + (-dx < px ? dx : -px);
+            for (int p = px - 1; p >= limit; p = (p & ~63) - 1) {
+                uint64_t word = row[p / 64] & (~0ULL >> (63 - p % 64));
+                if (word) {
+                    int hit = (p & ~63) + highestBit(word);
+                    return (hit >= limit ? hit + 1 : limit) - 1;
+                }
+            }
+            return limit - 1;
+        }
+        return x;
+    }
+
+    // The same along column x for a move of `dy` rows, one bit scan per
+    // band of rows crossed.
+    int sweepY(int x, int y, int dy) const {
+        assert(x >= -1 && x <= width && y >= -1 && y <= height);
+        int px = x + 1, py = y + 1;
+        if (dy > 0) {
+            int limit = py + (dy < height - y ? dy : height - y);
+            for (int p = py + 1; p <= limit; p = (p | (BAND_ROWS - 1)) + 1) {
+                uint32_t bits = band(p).columns[px] & (~0u << (p & (BAND_ROWS - 1)));
+                if (bits) {
+                    int hit = (p & ~(BAND_ROWS - 1)) + lowestBit(bits);
+                    return (hit <= limit ? hit - 1 : limit) - 1;
+                }
+            }
+            return limit - 1;
+        }
+        if (dy < 0) {
+            int limit = py + (-dy < py ? dy : -py);
+            for (int p = py - 1; p >= limit; p = (p & ~(BAND_ROWS - 1)) - 1) {
+                uint32_t bits = band(p).columns[px] & (~0u >> (31 - (p & (BAND_ROWS - 1))));
+                if (bits) {
+                    int hit = (p & ~(BAND_ROWS - 1)) + highestBit(bits);
+                    return (hit >= limit ? hit + 1 : limit) - 1;
+                }
+            }
+            return limit - 1;
+        }
+        return y;
+    }
+
+    // Same range as isBlocked; border cells read as '#'.
+    char getTile(int x, int y) const {
+        return band(y + 1).tiles[tileIndex(x, y)];
+    }
+
+    // Entity occupying the cell, or nullptr. Any coordinates are accepted.
+    const Entity* entityAt(int x, int y) const {
+        if (y < 0 || y >= height || x < 0 || x >= width) return nullptr;
+        uint16_t index = band(y + 1).entityIndex[tileIndex(x, y)];
+        const std::vector<Entity>& entities = *root->entities;
+        return index && index <= entities.size() ? &entities[index - 1] : nullptr;
+    }
+
+    bool isDoor(int x, int y) const {
+        const Entity* e = entityAt(x, y);
+        return e && e->type == EntityType::Door && e->active;
+    }
+
+    bool isGoal(int x, int y) const {
+        const Entity* e = entityAt(x, y);
+        return e && e->type == EntityType::Goal && e->active;
+    }
+
+    // The map in its padded row layout: storedRows(height) rows of
+    // width + 2 tiles, of maskWordsPerRow(width) solidity words and of
+    // width + 2 entity indexes (into entities(), plus one), border included,
+    // then columnWords(width, height) words of solidity by column, width + 2
+    // per band of rows. Level files store exactly this, so loading one maps
+    // it in place.
+    void copyRows(char* tiles, uint64_t* solid, uint16_t* entityIndex, uint16_t* columns) const {
+        for (size_t i = 0; i < root->bands.size(); i++) {
+            const Band& b = *root->bands[i];
+            size_t bandColumns = b.cells / BAND_ROWS;
+            std::memcpy(tiles + i * b.cells, b.tiles, b.cells);
+            std::memcpy(solid + i * b.words, b.solid, b.words * sizeof(uint64_t));
+            std::memcpy(entityIndex + i * b.cells, b.entityIndex, b.cells * sizeof(uint16_t));
+            std::memcpy(columns + i * bandColumns, b.columns, bandColumns * sizeof(uint16_t));
+        }
+    }
+
+    // Column solidity words (see copyRows) for a level of this shape.
+    static size_t columnWords(int w, int h) {
+        return (size_t)(storedRows(h) >> BAND_SHIFT) * (w + 2);
+    }
+
+    // A level that reads rows in copyRows' layout in place, without copying
+    // them; `owner` keeps the rows alive for as long as any copy still reads
+    // a band of them. A band is copied out the first time it is written.
+    static Level mapRows(int w, int h, const char* tiles, const uint64_t* solid, const uint16_t* entityIndex,
+                         const uint16_t* columns, std::vector<Entity> entities, std::shared_ptr<const void> owner) {
+        Level level(w, h, nullptr);
+        level.root = std::make_shared<Storage>();
+        level.root->revision = nextRevision();
+        level.root->bands.resize(storedRows(h) >> BAND_SHIFT);
+        for (size_t i = 0; i < level.root->bands.size(); i++) {
+            auto b = std::make_shared<Band>();
+            b->cells = level.bandCells();
+            b->words = level.bandWords();
+            b->tiles = tiles + i * b->cells;
+            b->solid = solid + i * b->words;
+            b->entityIndex = entityIndex + i * b->cells;
+            b->columns = columns + i * (b->cells / BAND_ROWS);
+            b->mapping = owner;
+            level.root->bands[i] = std::move(b);
+        }
+        level.root->entities = std::make_shared<std::vector<Entity>>(std::move(entities));
+        return level;
+    }
+
+    const std::vector<Entity>& entities() const { return *root->entities; }
+
+    // Heap bytes of map storage this level does not share with `base`, the
+    // level it was copied from: none for a fresh copy, then one band per
+    // written band. Other copies of this level (undo saves, snapshots) may
+    // share the same bytes.
+    size_t privateBytes(const Level& base) const {
+        if (!root || root == base.root) return 0;
+        size_t bytes = sizeof(Storage) + root->bands.capacity() * sizeof(std::shared_ptr<Band>);
+        for (size_t i = 0; i < root->bands.size(); i++) {
+            const std::shared_ptr<Band>& b = root->bands[i];
+            if (base.root && i < base.root->bands.size() && b == base.root->bands[i]) continue;
+            bytes += sizeof(Band) + b->ownTiles.capacity() + b->ownSolid.capacity() * sizeof(uint64_t)
+                   + (b->ownEntityIndex.capacity() + b->ownColumns.capacity()) * sizeof(uint16_t);
+        }
+        if (!base.root || root->entities != base.root->entities)
+            bytes += sizeof(std::vector<Entity>) + root->entities->capacity() * sizeof(Entity);
+        return bytes;
+    }
+
+    // Changes on every write; two copies with the same revision hold the
+    // same map.
+    uint64_t revision() const { return root ? root->revision : 0; }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+};
+
+#endif
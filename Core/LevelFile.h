@@ -0,0 +1,261 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Level.h"
+#include "LevelSource.h"
+#include "MappedFile.h"
+
+// Compiled level (.lvb): a LevelFileHeader, the solidity mask, tiles,
+// entity indexes and column solidity in Level's own padded row layout (see
+// Level::copyRows), then one LevelFileEntity per door or goal. Sections
+// start on 8-byte boundaries and everything is in host byte order, so a
+// loaded Level reads its rows straight from the mapping: nothing is parsed
+// or copied, and only the rows a game touches are ever paged in. Sources (.lvl, see
+// LevelSource.h) compile to this on first use or with the levelpack tool.
+
+const uint16_t LEVEL_FILE_VERSION = 3;
+
+struct LevelFileHeader {
+    char magic[4];          // "LVLB"
+    uint16_t version;       // LEVEL_FILE_VERSION
+    uint16_t entitySize;    // sizeof(LevelFileEntity)
+    int32_t width;
+    int32_t height;
+    int32_t spawnX;
+    int32_t spawnY;
+    int32_t goalX;          // -1, -1 if the level has no goal
+    int32_t goalY;
+    uint32_t entityCount;
+    uint32_t maskStride;    // Level::maskWordsPerRow(width)
+    uint64_t contentHash;   // levelContentHash() of the sections; identifies the level
+};
+static_assert(sizeof(LevelFileHeader) == 48, "LevelFileHeader is an on-disk record");
+
+struct LevelFileEntity {
+    uint8_t type;           // EntityType
+    uint8_t active;
+    uint8_t reserved[2];
+    int32_t x;
+    int32_t y;
+};
+static_assert(sizeof(LevelFileEntity) == 12, "LevelFileEntity is an on-disk record");
+
+// Byte offsets of each section for a level of the given shape.
+struct LevelFileLayout {
+    size_t solid, tiles, entityIndex, columns, entities, total;
+
+    LevelFileLayout(int width, int height, size_t entityCount) {
+        size_t rows = (size_t)Level::storedRows(height);
+        size_t cells = rows * ((size_t)width + 2);
+        solid = sizeof(LevelFileHeader);
+        tiles = solid + rows * Level::maskWordsPerRow(width) * sizeof(uint64_t);
+        entityIndex = tiles + (cells + 7) / 8 * 8;
+        columns = entityIndex + (cells * sizeof(uint16_t) + 7) / 8 * 8;
+        entities = columns + (Level::columnWords(width, height) * sizeof(uint16_t) + 7) / 8 * 8;
+        total = entities + entityCount * sizeof(LevelFileEntity);
+    }
+};
+
+// FNV-1a over the bytes after the header. Computed once when the level is
+// compiled, so loading a large level does not read all of it to check.
+inline uint64_t levelContentHash(const char* data, size_t size) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// A compiled level mapped read-only. Levels loaded from it keep it mapped
+// until the last of their unwritten rows is released.
+class LevelFile : public std::enable_shared_from_this<LevelFile> {
+    MappedFile map;
+
+    LevelFile() = default;
+
+    template <class T>
+    const T* section(size_t offset) const {
+        return reinterpret_cast<const T*>(map.data() + offset);
+    }
+
+public:
+    LevelFile(const LevelFile&) = delete;
+    LevelFile& operator=(const LevelFile&) = delete;
+
+    // Maps `path`; returns nullptr if it is missing, not a compiled level,
+    // or from another format version.
+    static std::shared_ptr<const LevelFile> open(const std::string& path) {
+        std::shared_ptr<LevelFile> f(new LevelFile());
+        if (!f->map.open(path) || f->map.size() < sizeof(LevelFileHeader)) return nullptr;
+
+        const LevelFileHeader& h = f->header();
+        if (std::memcmp(h.magic, "LVLB", 4) != 0 || h.version != LEVEL_FILE_VERSION
+            || h.entitySize != sizeof(LevelFileEntity)
+            || h.width < 1 || h.height < 1 || h.width > MAX_LEVEL_SIDE || h.height > MAX_LEVEL_SIDE
+            || (uint64_t)h.width * h.height > MAX_LEVEL_CELLS || h.entityCount > MAX_LEVEL_ENTITIES
+            || h.maskStride != (uint32_t)Level::maskWordsPerRow(h.width)
+            || LevelFileLayout(h.width, h.height, h.entityCount).total != f->map.size())
+            return nullptr;
+        return f;
+    }
+
+    const LevelFileHeader& header() const {
+        return *section<LevelFileHeader>(0);
+    }
+
+    // Replaces `level` with this one, read in place from the mapping; the
+    // cost does not depend on the level's size.
+    void load(Level& level) const {
+        const LevelFileHeader& h = header();
+        LevelFileLayout layout(h.width, h.height, h.entityCount);
+
+        std::vector<Entity> entities(h.entityCount);
+        const LevelFileEntity* records = section<LevelFileEntity>(layout.entities);
+        for (uint32_t i = 0; i < h.entityCount; i++)
+            entities[i] = { (EntityType)records[i].type, records[i].x, records[i].y, records[i].active != 0 };
+
+        level = Level::mapRows(h.width, h.height, section<char>(layout.tiles), section<uint64_t>(layout.solid),
+                               section<uint16_t>(layout.entityIndex), section<uint16_t>(layout.columns),
+                               std::move(entities), shared_from_this());
+        level.goalX = h.goalX;
+        level.goalY = h.goalY;
+    }
+};
+
+// Writes `source` in compiled form. The file is written beside `path` and
+// renamed over it, so a reader never maps a half-written level.
+inline bool writeLevelFile(const std::string& path, const LevelSource& source, std::string& error) {
+    const Level& level = source.level;
+    const std::vector<Entity>& entities = level.entities();
+    LevelFileLayout layout(level.getWidth(), level.getHeight(), entities.size());
+    std::vector<char> bytes(layout.total, 0);
+
+    LevelFileHeader h = {};
+    std::memcpy(h.magic, "LVLB", 4);
+    h.version = LEVEL_FILE_VERSION;
+    h.entitySize = sizeof(LevelFileEntity);
+    h.width = level.getWidth();
+    h.height = level.getHeight();
+    h.spawnX = source.spawnX;
+    h.spawnY = source.spawnY;
+    h.goalX = level.goalX;
+    h.goalY = level.goalY;
+    h.entityCount = (uint32_t)entities.size();
+    h.maskStride = (uint32_t)Level::maskWordsPerRow(level.getWidth());
+
+    // Through aligned buffers; the byte vector itself is only char-aligned.
+    std::vector<uint64_t> solid((layout.tiles - layout.solid) / sizeof(uint64_t));
+    std::vector<uint16_t> entityIndex((size_t)Level::storedRows(level.getHeight()) * (level.getWidth() + 2));
+    std::vector<uint16_t> columns(Level::columnWords(level.getWidth(), level.getHeight()));
+    level.copyRows(bytes.data() + layout.tiles, solid.data(), entityIndex.data(), columns.data());
+    std::memcpy(bytes.data() + layout.solid, solid.data(), solid.size() * sizeof(uint64_t));
+    std::memcpy(bytes.data() + layout.entityIndex, entityIndex.data(), entityIndex.size() * sizeof(uint16_t));
+    std::memcpy(bytes.data() + layout.columns, columns.data(), columns.size() * sizeof(uint16_t));
+
+    for (size_t i = 0; i < entities.size(); i++) {
+        LevelFileEntity e = {};
+        e.type = (uint8_t)entities[i].type;
+        e.active = entities[i].active ? 1 : 0;
+        e.x = entities[i].x;
+        e.y = entities[i].y;
+        std::memcpy(bytes.data() + layout.entities + i * sizeof(e), &e, sizeof(e));
+    }
+    h.contentHash = levelContentHash(bytes.data() + sizeof(h), bytes.size() - sizeof(h));
+    std::memcpy(bytes.data(), &h, sizeof(h));
+
+    std::string temp = path + ".tmp";
+    FILE* file = std::fopen(temp.c_str(), "wb");
+    bool written = file && std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    if (file && std::fclose(file) != 0) written = false;
+    std::error_code ec;
+    if (written) std::filesystem::rename(temp, path, ec);
+    if (!written || ec) {
+        std::filesystem::remove(temp, ec);
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+// Parses, validates and compiles one source file.
+inline bool compileLevel(const std::string& sourcePath, const std::string& outputPath, std::string& error) {
+    std::ifstream in(sourcePath);
+    if (!in) {
+        error = "cannot read " + sourcePath;
+        return false;
+    }
+    LevelSource source;
+    if (!parseLevelSource(in, source, error)) {
+        error = sourcePath + ": " + error;
+        return false;
+    }
+    return writeLevelFile(outputPath, source, error);
+}
+
+// `dir` if it exists, else a directory of that name beside the executable
+// at `executable`, where the build copies the levels; a game started from
+// outside its source directory still finds them.
+inline std::string findLevelDir(const std::string& dir, const std::string& executable) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (fs::is_directory(dir, ec) || fs::path(dir).is_absolute()) return dir;
+    fs::path beside = fs::path(executable).parent_path() / dir;
+    return fs::is_directory(beside, ec) ? beside.string() : dir;
+}
+
+// Every level in `dir`, keyed by the number its file is named after
+// (3.lvl -> 3). A source newer than its compiled file, or without a
+// loadable one (e.g. from an older format version), is compiled first, so
+// edits take effect on the next start; a directory of .lvb files alone
+// works too. Problems are appended to `errors`.
+inline std::map<int, std::shared_ptr<const LevelFile>> loadLevelPack(const std::string& dir, std::vector<std::string>& errors) {
+    namespace fs = std::filesystem;
+    std::map<int, std::shared_ptr<const LevelFile>> levels;
+
+    std::error_code ec;
+    std::vector<fs::path> paths;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+        paths.push_back(it->path());
+    if (ec) {
+        errors.push_back("cannot read level directory " + dir);
+        return levels;
+    }
+
+    for (const fs::path& path : paths) {
+        std::string stem = path.stem().string();
+        std::string ext = path.extension().string();
+        if (stem.empty() || stem.size() > 9 || stem.find_first_not_of("0123456789") != std::string::npos) continue;
+        if (ext != ".lvl" && ext != ".lvb") continue;
+        int id = std::stoi(stem);
+        if (levels.count(id)) continue;
+
+        fs::path source = path.parent_path() / (stem + ".lvl");
+        fs::path compiled = path.parent_path() / (stem + ".lvb");
+        bool compileFailed = false;
+        if (fs::exists(source, ec)) {
+            std::error_code ignored;
+            bool stale = !fs::exists(compiled, ignored)
+                || fs::last_write_time(source, ignored) > fs::last_write_time(compiled, ignored)
+                || !LevelFile::open(compiled.string());
+            std::string error;
+            if (stale && !compileLevel(source.string(), compiled.string(), error)) {
+                errors.push_back(error);
+                compileFailed = true;
+            }
+        }
+
+        // After a failed compile an older compiled file, if any, still loads.
+        auto file = LevelFile::open(compiled.string());
+        if (file) levels[id] = std::move(file);
+        else if (!compileFailed) errors.push_back("cannot load " + compiled.string());
+    }
+    return levels;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <sstream>
+#include <string>
+#include "Level.h"
+
+// Text form of a level, one directive per line; '#' starts a comment.
+//
+//   size W H            level size in cells; must come first
+//   spawn X Y           where the player starts; required
+//   ground              solid bottom row
+//   walls               solid left and right columns
+//   platform Y X LEN    LEN solid cells rightwards from (X, Y)
+//   door X Y
+//   goal X Y            at most one; a level without one never ends
+//
+// Sources are only read by the level compiler (LevelFile.h); the games load
+// the compiled form.
+
+// Levels are stored as ~3 bytes per cell (see LevelFile.h); the cell cap
+// keeps a compiled level under a gigabyte.
+const int MAX_LEVEL_SIDE = 65536;
+const uint64_t MAX_LEVEL_CELLS = 1ULL << 28;
+
+struct LevelSource {
+    Level level;
+    int spawnX = -1, spawnY = -1;
+};
+
+// Parses and validates a source. On failure returns false and sets `error`
+// to "line N: ..." (or a whole-level problem without a line number).
+inline bool parseLevelSource(std::istream& in, LevelSource& out, std::string& error) {
+    bool sized = false, hasGoal = false;
+    int lineNo = 0;
+    std::string line;
+
+    auto fail = [&](const std::string& message) {
+        error = "line " + std::to_string(lineNo) + ": " + message;
+        return false;
+    };
+
+    while (std::getline(in, line)) {
+        lineNo++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+
+        std::istringstream words(line);
+        std::string directive;
+        if (!(words >> directive)) continue;
+
+        int args[3];
+        int argCount = 0;
+        while (argCount < 3 && words >> args[argCount]) argCount++;
+        if (!words.eof()) words >> std::ws;
+        if (!words.eof()) return fail("bad arguments to '" + directive + "'");
+
+        auto expect = [&](int n) { return argCount == n; };
+        auto inside = [&](int x, int y) {
+            return x >= 0 && x < out.level.getWidth() && y >= 0 && y < out.level.getHeight();
+        };
+
+        if (directive == "size") {
+            if (sized) return fail("size given twice");
+            if (!expect(2)) return fail("usage: size W H");
+            if (args[0] < 1 || args[1] < 1 || args[0] > MAX_LEVEL_SIDE || args[1] > MAX_LEVEL_SIDE)
+                return fail("size must be 1.." + std::to_string(MAX_LEVEL_SIDE) + " on each side");
+            if ((uint64_t)args[0] * args[1] > MAX_LEVEL_CELLS)
+                return fail("level has more than " + std::to_string(MAX_LEVEL_CELLS) + " cells");
+            out.level = Level(args[0], args[1]);
+            sized = true;
+            continue;
+        }
+        if (!sized) return fail("'size' must come first");
+
+        if (directive == "spawn") {
+            if (!expect(2)) return fail("usage: spawn X Y");
+            if (!inside(args[0], args[1])) return fail("spawn is outside the level");
+            out.spawnX = args[0];
+            out.spawnY = args[1];
+        }
+        else if (directive == "ground") {
+            if (!expect(0)) return fail("usage: ground");
+            out.level.createFullGround();
+        }
+        else if (directive == "walls") {
+            if (!expect(0)) return fail("usage: walls");
+            out.level.createWalls();
+        }
+        else if (directive == "platform") {
+            if (!expect(3)) return fail("usage: platform Y X LEN");
+            int y = args[0], x = args[1], length = args[2];
+            if (length < 1 || !inside(x, y) || x + length > out.level.getWidth())
+                return fail("platform does not fit in the level");
+            out.level.createPlatform(y, x, length);
+        }
+        else if (directive == "door" || directive == "goal") {
+            if (!expect(2)) return fail("usage: " + directive + " X Y");
+            int x = args[0], y = args[1];
+            if (!inside(x, y)) return fail(directive + " is outside the level");
+            if (out.level.entityAt(x, y)) return fail("cell already holds a door or goal");
+            if (out.level.entities().size() >= MAX_LEVEL_ENTITIES) return fail("too many entities");
+            if (directive == "door") {
+                out.level.addDoor(x, y);
+            } else {
+                if (hasGoal) return fail("goal given twice");
+                out.level.setGoal(x, y);
+                hasGoal = true;
+            }
+        }
+        else {
+            return fail("unknown directive '" + directive + "'");
+        }
+    }
+
+    if (!sized) {
+        error = "missing 'size'";
+        return false;
+    }
+    if (out.spawnX < 0) {
+        error = "missing 'spawn'";
+        return false;
+    }
+    // Solid cells are checked last, as a later platform may cover them.
+    if (out.level.isBlocked(out.spawnX, out.spawnY)) {
+        error = "spawn is inside a solid cell";
+        return false;
+    }
+    for (const Entity& e : out.level.entities()) {
+        if (out.level.isBlocked(e.x, e.y)) {
+            error = "door or goal at " + std::to_string(e.x) + "," + std::to_string(e.y) + " is inside a solid cell";
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A whole file mapped read-only. Pages are loaded on first touch and shared
+// with every other process mapping the same file.
+class MappedFile {
+    const char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+#else
+        if (bytes) munmap((void*)bytes, length);
+#endif
+    }
+
+    // Maps `path`; false if it is missing or empty (an empty file cannot be
+    // mapped).
+    bool open(const std::string& path) {
+#ifdef _WIN32
+        HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(handle, &fileSize) && fileSize.QuadPart > 0) {
+            length = (size_t)fileSize.QuadPart;
+            mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) bytes = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+        CloseHandle(handle);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            length = (size_t)st.st_size;
+            void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) bytes = (const char*)p;
+        }
+        ::close(fd);
+#endif
+        return bytes != nullptr;
+    }
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+};
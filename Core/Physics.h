@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include "Player.h"
+#include "Level.h"
+
+// Platform-neutral movement rules shared by the console games and the web
+// server. Nothing here does I/O or keeps global state. Everything is
+// templated on the velocity type so the same rules run in double or in
+// deterministic fixed point (see Scalar.h).
+
+template <class Num>
+struct BasicPhysicsConfig {
+    Num gravity = Num(0.4);
+    Num jump = Num(-2.0);
+    Num maxFall = Num(2.0);
+};
+
+using PhysicsConfig = BasicPhysicsConfig<Scalar>;
+
+// Bitmask of the controls held during one tick.
+enum InputBits : uint8_t {
+    INPUT_NONE = 0,
+    INPUT_LEFT = 1,
+    INPUT_RIGHT = 2,
+    INPUT_JUMP = 4,
+};
+
+// Horizontal moves are one cell per press; a jump only starts from the ground.
+template <class Num>
+void applyInput(BasicPlayer<Num>& player, const Level& level, const BasicPhysicsConfig<Num>& config, uint8_t inputs) {
+    if (inputs & INPUT_LEFT) {
+        player.x = level.sweepX(player.x, player.y, -1);
+    }
+    if (inputs & INPUT_RIGHT) {
+        player.x = level.sweepX(player.x, player.y, 1);
+    }
+    if ((inputs & INPUT_JUMP) && player.grounded) {
+        player.vy = config.jump;
+        player.grounded = false;
+    }
+}
+
+// Gravity and vertical movement for one tick. The whole move is swept
+// against the level in one call (see Level::sweepY), so the player stops
+// short of the first platform in the way at any speed.
+template <class Num>
+void stepPhysics(BasicPlayer<Num>& player, const Level& level, const BasicPhysicsConfig<Num>& config) {
+    if (!player.grounded) {
+        player.vy += config.gravity;
+        if (player.vy > config.maxFall) player.vy = config.maxFall;
+    }
+
+    int steps = roundAbs(player.vy);
+    int dir = (player.vy > Num(0)) ? 1 : -1;
+
+    int target = player.y + dir * steps;
+    player.y = level.sweepY(player.x, player.y, dir * steps);
+    if (player.y != target) {
+        player.vy = Num(0);
+        if (dir > 0) player.grounded = true;
+    }
+
+    if (level.isBlocked(player.x, player.y + 1)) {
+        player.grounded = true;
+        player.vy = Num(0);
+    } else {
+        player.grounded = false;
+    }
+}
+
+// Stable fingerprint of a player's full state, for checking that two runs
+// (or two machines) simulated identically.
+template <class Num>
+uint64_t stateHash(const BasicPlayer<Num>& player, uint64_t hash = 1469598103934665603ULL) {
+    uint64_t fields[] = { uint64_t(uint32_t(player.x)), uint64_t(uint32_t(player.y)),
+                          rawBits(player.vy), uint64_t(player.grounded) };
+    for (uint64_t field : fields) {
+        hash ^= field;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Fingerprint of the physics constants and their numeric type. Recordings
+// only re-simulate correctly under the configuration they were made with.
+template <class Num>
+uint64_t configHash(const BasicPhysicsConfig<Num>& config, uint64_t hash = 1469598103934665603ULL) {
+    uint64_t fields[] = { uint64_t(sizeof(Num)), rawBits(config.gravity), rawBits(config.jump),
+                          rawBits(config.maxFall) };
+    for (uint64_t field : fields) {
+        hash ^= field;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
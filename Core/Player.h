@@ -0,0 +1,12 @@
+#pragma once
+#include "Scalar.h"
+
+template <class Num>
+struct BasicPlayer {
+    int x = 5;
+    int y = 10;
+    Num vy = Num(0);
+    bool grounded = true;
+};
+
+using Player = BasicPlayer<Scalar>;
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Fixed-capacity stack that overwrites its oldest entry when full. Storage
+// is allocated once up front, so pushes never allocate. Popped and cleared
+// slots are reset, so nothing they held (e.g. shared level storage)
+// outlives its entry.
+template <class T>
+class RingStack {
+    std::vector<T> slots;
+    size_t head = 0;    // slot the next push goes into
+    size_t count = 0;
+    unsigned long long droppedCount = 0;
+
+public:
+    explicit RingStack(size_t capacity) : slots(capacity ? capacity : 1) {}
+
+    void push(const T& value) {
+        slots[head] = value;
+        head = (head + 1) % slots.size();
+        if (count == slots.size()) droppedCount++;
+        else count++;
+    }
+
+    // Caller must check empty() first.
+    void pop() {
+        head = (head + slots.size() - 1) % slots.size();
+        slots[head] = T();
+        count--;
+    }
+
+    const T& top() const {
+        return slots[(head + slots.size() - 1) % slots.size()];
+    }
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    size_t capacity() const { return slots.size(); }
+
+    // Entries overwritten because the stack was full.
+    unsigned long long dropped() const { return droppedCount; }
+
+    void clear() {
+        for (size_t i = 0; i < count; i++) slots[(head + slots.size() - 1 - i) % slots.size()] = T();
+        head = 0;
+        count = 0;
+    }
+};
@@ -0,0 +1,11 @@
+#pragma once
+#include "Fixed.h"
+
+// Numeric type for velocities. Define GAME_FIXED_POINT to simulate in
+// Q16.16 fixed point, which is bit-exact across compilers and machines;
+// the default double matches the original tuning exactly.
+#ifdef GAME_FIXED_POINT
+using Scalar = Fixed16;
+#else
+using Scalar = double;
+#endif
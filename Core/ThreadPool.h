@@ -0,0 +1,98 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. parallelFor() splits
+// [0, count) into grain-sized chunks that the workers and the calling thread
+// take in turn, and returns once every chunk is done. Threads are started
+// once and sleep between calls, so a call costs a wake-up, not a spawn.
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+
+    // The loop in progress; only touched under `mutex` or by its chunks.
+    const std::function<void(size_t, size_t)>* job = nullptr;
+    size_t count = 0, grain = 1;
+    std::atomic<size_t> nextChunk{0};
+    size_t busy = 0;                // workers still on this generation
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    void runChunks() {
+        for (;;) {
+            size_t begin = nextChunk.fetch_add(grain);
+            if (begin >= count) return;
+            (*job)(begin, std::min(begin + grain, count));
+        }
+    }
+
+    void workerLoop() {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+            runChunks();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0) done.notify_one();
+        }
+    }
+
+public:
+    // `threads` counts the calling thread; 0 means one per hardware thread.
+    explicit ThreadPool(unsigned threads = 0) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 1; i < threads; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : workers) t.join();
+    }
+
+    unsigned size() const { return (unsigned)workers.size() + 1; }
+
+    // Calls fn(begin, end) over disjoint ranges covering [0, n). Chunks may
+    // run concurrently; fn must only write to its own range.
+    void parallelFor(size_t n, size_t chunk, const std::function<void(size_t, size_t)>& fn) {
+        if (chunk == 0) chunk = 1;
+        if (workers.empty() || n <= chunk) {
+            if (n) fn(0, n);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            count = n;
+            grain = chunk;
+            nextChunk = 0;
+            busy = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        runChunks();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return busy == 0; });
+        job = nullptr;
+    }
+};
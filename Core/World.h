@@ -0,0 +1,53 @@
+#pragma once
+#include "Player.h"
+#include "Level.h"
+#include "Physics.h"
+
+// One self-contained game: a level, the player in it and the rules that
+// move them. step() is everything a front-end needs per frame.
+template <class Num>
+class BasicWorld {
+public:
+    Level level;
+    BasicPlayer<Num> player;
+    BasicPhysicsConfig<Num> config;
+
+    BasicWorld(int width, int height, BasicPhysicsConfig<Num> physics = BasicPhysicsConfig<Num>())
+        : level(width, height), config(physics) {}
+
+    void spawn(int x, int y) {
+        player.x = x;
+        player.y = y;
+        player.vy = Num(0);
+        player.grounded = true;
+    }
+
+    // Applies this tick's held inputs, then gravity.
+    void step(uint8_t inputs) {
+        applyInput(player, level, config, inputs);
+        stepPhysics(player, level, config);
+    }
+
+    // The whole world at one moment. The level is copy-on-write, so taking
+    // or restoring a snapshot costs a pointer copy; only bands written
+    // afterwards are duplicated.
+    struct Snapshot {
+        BasicPlayer<Num> player;
+        Level level;
+    };
+
+    Snapshot snapshot() const {
+        return { player, level };
+    }
+
+    void restore(const Snapshot& s) {
+        player = s.player;
+        level = s.level;
+    }
+
+    bool atGoal() const {
+        return level.isGoal(player.x, player.y);
+    }
+};
+
+using World = BasicWorld<Scalar>;
@@ -0,0 +1,154 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Camera.h"
+#include "Level.h"
+#include "StateEncoder.h"
+#include "StateSnapshot.h"
+
+// Compact little-endian encoding of /state, sent when the client asks for
+// application/octet-stream. Layout:
+//
+//   u8  format version (BINARY_STATE_VERSION)
+//   u8  flags: BIN_PLAYER | BIN_MESSAGES | BIN_GRID
+//   u16 level id
+//   u32 tick
+//   u32 level version
+//   [BIN_PLAYER]   i32 x, i32 y, f32 vy, u8 grounded
+//   [BIN_MESSAGES] u16 tutorial id, u16 goal message id, u8 choice count,
+//                  then per choice: u8 choice id, u16 text id
+//   [BIN_GRID]     u32 level width, u32 level height, u32 view x,
+//                  u32 view y, u16 view width, u16 view height, then 2 bits
+//                  per tile in the view, row-major, lowest bits first (see
+//                  TileCode)
+//
+// Message ids index the table served by GET /strings; id 0 is "".
+
+const uint8_t BINARY_STATE_VERSION = 2;
+
+enum BinaryFlags : uint8_t {
+    BIN_PLAYER = 1,
+    BIN_MESSAGES = 2,
+    BIN_GRID = 4,
+};
+
+enum TileCode : uint8_t {
+    TILE_EMPTY = 0,
+    TILE_PLATFORM = 1,
+    TILE_GOAL = 2,
+    TILE_DOOR = 3,
+};
+
+// Interns message strings so the binary format can refer to them by id.
+class StringTable {
+    std::mutex mutex;
+    std::vector<std::string> strings{""};
+    std::unordered_map<std::string, uint16_t> ids{{"", 0}};
+
+public:
+    uint16_t intern(const std::string& s) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = ids.find(s);
+        if (it != ids.end()) return it->second;
+        uint16_t id = (uint16_t)strings.size();
+        strings.push_back(s);
+        ids[s] = id;
+        return id;
+    }
+
+    std::vector<std::string> all() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return strings;
+    }
+};
+
+class BinaryWriter {
+    std::string out;
+
+public:
+    void u8(uint8_t v) { out += (char)v; }
+    void u16(uint16_t v) { u8(v & 0xFF); u8(v >> 8); }
+    void u32(uint32_t v) { u16(v & 0xFFFF); u16(v >> 16); }
+    void i32(int32_t v) { u32((uint32_t)v); }
+    void f32(float v) {
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        u32(bits);
+    }
+    void bytes(const std::string& b) { out += b; }
+
+    std::string take() { return std::move(out); }
+};
+
+inline uint8_t tileCode(const Level& level, int x, int y) {
+    if (level.isGoal(x, y)) return TILE_GOAL;
+    if (level.isDoor(x, y)) return TILE_DOOR;
+    switch (level.getTile(x, y)) {
+        case '#': return TILE_PLATFORM;
+        case 'G': return TILE_GOAL;
+        case 'D': return TILE_DOOR;
+        default: return TILE_EMPTY;
+    }
+}
+
+// The BIN_GRID section for a window of the level.
+inline std::shared_ptr<const std::string> packGrid(const Level& level, int left, int top, int width, int height) {
+    BinaryWriter w;
+    w.u32((uint32_t)level.getWidth());
+    w.u32((uint32_t)level.getHeight());
+    w.u32((uint32_t)left);
+    w.u32((uint32_t)top);
+    w.u16((uint16_t)width);
+    w.u16((uint16_t)height);
+
+    std::string packed((width * height + 3) / 4, '\0');
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int i = y * width + x;
+            packed[i / 4] |= (char)(tileCode(level, left + x, top + y) << ((i % 4) * 2));
+        }
+    }
+    w.bytes(packed);
+    return std::make_shared<const std::string>(w.take());
+}
+
+inline std::string encodeBinaryState(const StateSnapshot& snap, const StateDelta& delta, const Camera& camera,
+                                     StringTable& strings) {
+    BinaryWriter w;
+    uint8_t flags = (delta.player ? BIN_PLAYER : 0) | (delta.messages ? BIN_MESSAGES : 0)
+                  | (delta.grid ? BIN_GRID : 0);
+
+    w.u8(BINARY_STATE_VERSION);
+    w.u8(flags);
+    w.u16((uint16_t)snap.levelID);
+    w.u32((uint32_t)snap.tick);
+    w.u32((uint32_t)snap.levelVersion);
+
+    if (delta.player) {
+        w.i32(snap.player.x);
+        w.i32(snap.player.y);
+        w.f32((float)toDouble(snap.player.vy));
+        w.u8(snap.player.grounded ? 1 : 0);
+    }
+
+    if (delta.messages) {
+        w.u16(strings.intern(snap.tutorial));
+        w.u16(strings.intern(snap.goalMessage));
+        w.u8((uint8_t)snap.choices.size());
+        for (auto& opt : snap.choices) {
+            w.u8((uint8_t)opt.first);
+            w.u16(strings.intern(opt.second));
+        }
+    }
+
+    if (delta.grid) {
+        if (snap.packedGrid && wholeLevel(snap, camera)) w.bytes(*snap.packedGrid);
+        else w.bytes(*packGrid(snap.level, camera.x, camera.y, camera.viewWidth, camera.viewHeight));
+    }
+    return w.take();
+}
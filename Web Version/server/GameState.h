@@ -1,6 +1,11 @@
 #pragma once
 #include "Player.h"
+#include "Level.h"
 
+// Everything in a session that the game can change. The level is
+// copy-on-write, so copying a GameState (a save, a replay keyframe) costs
+// a pointer, not a grid.
 struct GameState {
     Player player;
+    Level level;
 };
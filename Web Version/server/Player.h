@@ -1,8 +0,0 @@
-#pragma once
-
-struct Player {
-    int x = 5;
-    int y = 10;
-    double vy = 0;
-    bool grounded = true;
-};
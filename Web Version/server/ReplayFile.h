@@ -0,0 +1,230 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "GameState.h"
+#include "MappedFile.h"
+
+// On-disk replay: a ReplayFileHeader followed by fixed-size ReplayEvent
+// records, appended in chunks as the run is played. Records are stored in
+// host byte order (little-endian on every platform we build for) so a
+// mapped file can be played back in place. A record with no inputs only
+// marks where the run ended; the last record's tick is the replay length.
+// A torn trailing record from a crash is ignored on load.
+
+struct ReplayEvent {
+    uint32_t tick;          // ticks since the replay started
+    uint8_t inputs;         // InputBits | ReplayBits; 0 marks progress only
+    uint8_t reserved[3];
+};
+static_assert(sizeof(ReplayEvent) == 8, "ReplayEvent is an on-disk record");
+
+const uint16_t REPLAY_FILE_VERSION = 2;
+
+struct ReplayFileHeader {
+    char magic[4];          // "RPLY"
+    uint16_t version;       // REPLAY_FILE_VERSION
+    uint16_t recordSize;    // sizeof(ReplayEvent)
+    uint32_t levelID;
+    int32_t startX;
+    int32_t startY;
+    uint8_t startGrounded;
+    uint8_t reserved[3];
+    double startVy;
+    uint64_t physicsHash;   // configHash() of the recording's physics
+    uint64_t levelHash;     // LevelFileHeader::contentHash of the level, 0 if none
+};
+static_assert(sizeof(ReplayFileHeader) == 48, "ReplayFileHeader is an on-disk record");
+
+// Does replay file writes on a thread of its own, in the order they were
+// queued, so recording sessions never wait on the disk. Writes beyond
+// MAX_PENDING are dropped and counted with the failed ones.
+class ReplayDisk {
+    struct Write {
+        std::string path;
+        bool create;            // truncate first; otherwise append
+        std::string bytes;
+    };
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Write> queue;
+    bool stopping = false;
+    unsigned long long failed = 0;
+    std::thread worker;
+
+public:
+    static const size_t MAX_PENDING = 4096;
+
+    ReplayDisk() : worker([this] { run(); }) {}
+
+    // Finishes the queued writes first.
+    ~ReplayDisk() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    void write(const std::string& path, bool create, std::string bytes) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue.size() >= MAX_PENDING) {
+                failed++;
+                return;
+            }
+            queue.push_back({ path, create, std::move(bytes) });
+        }
+        wake.notify_one();
+    }
+
+    unsigned long long failures() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return failed;
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;
+            Write w = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            // The file is only open while a chunk is written, so thousands of
+            // recording sessions do not hold thousands of descriptors.
+            FILE* file = std::fopen(w.path.c_str(), w.create ? "wb" : "ab");
+            bool written = file && std::fwrite(w.bytes.data(), 1, w.bytes.size(), file) == w.bytes.size();
+            if (file && std::fclose(file) != 0) written = false;
+            lock.lock();
+            if (!written) failed++;
+        }
+    }
+};
+
+// Defined ahead of anything that records, so it is destroyed after the
+// last writer has handed over its final chunk.
+inline ReplayDisk replayDisk;
+
+// Appends one run to a file. Records are buffered and handed to
+// replayDisk a chunk at a time; flush() passes on what is buffered
+// without forcing it to disk.
+class ReplayWriter {
+    std::string path;
+    std::vector<ReplayEvent> pending;
+    uint32_t lastTick = 0;
+    bool closed = false;
+
+public:
+    static const size_t CHUNK_RECORDS = 512;
+
+    ReplayWriter(const ReplayWriter&) = delete;
+    ReplayWriter& operator=(const ReplayWriter&) = delete;
+
+    ReplayWriter(const std::string& filePath, int levelID, const GameState& start,
+                 uint64_t physicsHash, uint64_t levelHash)
+        : path(filePath) {
+        ReplayFileHeader h = {};
+        std::memcpy(h.magic, "RPLY", 4);
+        h.version = REPLAY_FILE_VERSION;
+        h.recordSize = sizeof(ReplayEvent);
+        h.levelID = (uint32_t)levelID;
+        h.startX = start.player.x;
+        h.startY = start.player.y;
+        h.startGrounded = start.player.grounded ? 1 : 0;
+        h.startVy = toDouble(start.player.vy);
+        h.physicsHash = physicsHash;
+        h.levelHash = levelHash;
+        replayDisk.write(path, true, std::string(reinterpret_cast<const char*>(&h), sizeof(h)));
+        pending.reserve(CHUNK_RECORDS);
+    }
+
+    ~ReplayWriter() { close(lastTick); }
+
+    void append(uint32_t tick, uint8_t inputs) {
+        if (closed) return;
+        pending.push_back({ tick, inputs, {0, 0, 0} });
+        lastTick = tick;
+        if (pending.size() >= CHUNK_RECORDS) flush();
+    }
+
+    // Passes on what is buffered, if anything.
+    void flush() {
+        if (pending.empty()) return;
+        replayDisk.write(path, false, std::string(reinterpret_cast<const char*>(pending.data()),
+                                                    pending.size() * sizeof(ReplayEvent)));
+        pending.clear();
+    }
+
+    // Ends the run at `tick`: a marker records its length if nothing was
+    // pressed on the last tick.
+    void close(uint32_t tick) {
+        if (closed) return;
+        if (tick > lastTick) append(tick, 0);
+        flush();
+        closed = true;
+    }
+};
+
+// A replay file mapped read-only; records are read straight from the
+// mapping, so opening a run costs nothing until it is played.
+class ReplayFile {
+    MappedFile map;
+
+    ReplayFile() = default;
+
+public:
+    ReplayFile(const ReplayFile&) = delete;
+    ReplayFile& operator=(const ReplayFile&) = delete;
+
+    // Maps `path`; returns nullptr if it is missing, not a replay, or was
+    // recorded under different physics than `physicsHash`. The level is
+    // checked by the caller, against header().levelHash.
+    static std::shared_ptr<const ReplayFile> open(const std::string& path, uint64_t physicsHash) {
+        std::shared_ptr<ReplayFile> f(new ReplayFile());
+        if (!f->map.open(path) || f->map.size() < sizeof(ReplayFileHeader)) return nullptr;
+
+        const ReplayFileHeader& h = f->header();
+        if (std::memcmp(h.magic, "RPLY", 4) != 0 || h.version != REPLAY_FILE_VERSION
+            || h.recordSize != sizeof(ReplayEvent) || h.physicsHash != physicsHash)
+            return nullptr;
+        return f;
+    }
+
+    const ReplayFileHeader& header() const {
+        return *reinterpret_cast<const ReplayFileHeader*>(map.data());
+    }
+
+    const ReplayEvent* events() const {
+        return reinterpret_cast<const ReplayEvent*>(map.data() + sizeof(ReplayFileHeader));
+    }
+
+    size_t eventCount() const {
+        return (map.size() - sizeof(ReplayFileHeader)) / sizeof(ReplayEvent);
+    }
+
+    uint32_t length() const {
+        size_t n = eventCount();
+        return n ? events()[n - 1].tick : 0;
+    }
+
+    GameState start() const {
+        const ReplayFileHeader& h = header();
+        GameState state;
+        state.player.x = h.startX;
+        state.player.y = h.startY;
+        state.player.vy = Scalar(h.startVy);
+        state.player.grounded = h.startGrounded != 0;
+        return state;
+    }
+};
@@ -1,27 +1,244 @@
 #pragma once
-#include <queue>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 #include "GameState.h"
+#include "Level.h"
+#include "Physics.h"
+#include "SaveManager.h"
+#include "ReplayFile.h"
+
+// A replay is the inputs applied since the level started, stamped with the
+// tick they were applied before, plus a full keyframe every
+// REPLAY_KEYFRAME_INTERVAL ticks in which the player sent input. Playback
+// re-runs the physics from the nearest keyframe, so seeking costs at most
+// one interval of steps plus any idle stretch before it; an idle session
+// records nothing.
+
+const uint32_t REPLAY_KEYFRAME_INTERVAL = 64;
+
+// Ticks between flushes of a streamed recording to its file.
+const uint32_t REPLAY_FLUSH_INTERVAL = 100;
+
+// Replay-only input bits, alongside the movement bits in InputBits.
+enum ReplayBits : uint8_t {
+    REPLAY_SAVE = 0x40,
+    REPLAY_UNDO = 0x80,
+};
+
+// Everything needed to resume playback at `tick`, taken after that tick's
+// inputs and before its physics step. Keyframes share the undo history
+// with the one before unless a save or undo came in between.
+struct ReplayKeyframe {
+    uint32_t tick;
+    size_t nextEvent;
+    GameState state;
+    std::shared_ptr<const SaveManager> saves;
+};
+
+// A view of a recording. Events and keyframes are shared with the recorder,
+// which only ever appends, so copying a replay never copies the log. A
+// replay loaded from disk reads its events from the mapped file instead.
+struct Replay {
+    int levelID = 0;
+    std::shared_ptr<const std::vector<ReplayEvent>> events;
+    std::shared_ptr<const ReplayFile> file;
+    std::shared_ptr<const std::vector<ReplayKeyframe>> keyframes;
+    size_t eventCount = 0;
+    size_t keyframeCount = 0;
+    uint32_t length = 0;    // ticks covered
+};
 
 class ReplayManager {
-    std::queue<GameState> replayQueue;
+    int levelID = 0;
+    unsigned long long startTick = 0;
+    uint32_t pausedAt = 0;
+    std::shared_ptr<std::vector<ReplayEvent>> events = std::make_shared<std::vector<ReplayEvent>>();
+    std::shared_ptr<std::vector<ReplayKeyframe>> keyframes = std::make_shared<std::vector<ReplayKeyframe>>();
+    std::unique_ptr<ReplayWriter> writer;
+    uint32_t lastFlush = 0;
+    bool savesChanged = false;      // since the last keyframe
+
 public:
-    void record(const GameState& state) {
-        replayQueue.push(state);
+    // Starts a new recording from `state` (and `saves`) at `tick`.
+    void begin(int level, unsigned long long tick, const GameState& state,
+               const SaveManager& saves = SaveManager()) {
+        if (writer) writer->close((uint32_t)(tick - startTick));
+        writer.reset();
+        levelID = level;
+        startTick = tick;
+        // Fresh logs, so replays still playing the old ones are unaffected.
+        events = std::make_shared<std::vector<ReplayEvent>>();
+        keyframes = std::make_shared<std::vector<ReplayKeyframe>>();
+        keyframes->push_back({ 0, 0, state, std::make_shared<const SaveManager>(saves) });
+        savesChanged = false;
+    }
+
+    // Also appends this recording to `path` as it is made, through
+    // replayDisk. Call right after begin().
+    void streamTo(const std::string& path, uint64_t physicsHash, uint64_t levelHash) {
+        writer.reset(new ReplayWriter(path, levelID, (*keyframes)[0].state, physicsHash, levelHash));
+        lastFlush = 0;
+    }
+
+    void record(unsigned long long tick, uint8_t inputs) {
+        uint32_t offset = (uint32_t)(tick - startTick);
+        events->push_back({ offset, inputs, {0, 0, 0} });
+        if (inputs & (REPLAY_SAVE | REPLAY_UNDO)) savesChanged = true;
+        if (writer) writer->append(offset, inputs);
+    }
+
+    // Hands the streamed file what was recorded every REPLAY_FLUSH_INTERVAL
+    // ticks, if anything was; no fsync, so a crash loses at most what the OS
+    // had not written.
+    void flushStream(unsigned long long tick) {
+        uint32_t offset = (uint32_t)(tick - startTick);
+        if (!writer || offset - lastFlush < REPLAY_FLUSH_INTERVAL) return;
+        writer->flush();
+        lastFlush = offset;
+    }
+
+    // Called before each live physics step; keeps a keyframe when one is due
+    // and there were inputs since the last one.
+    void keyframe(unsigned long long tick, const GameState& state, const SaveManager& saves) {
+        uint32_t offset = (uint32_t)(tick - startTick);
+        const ReplayKeyframe& last = keyframes->back();
+        if (offset % REPLAY_KEYFRAME_INTERVAL != 0 || last.tick == offset || last.nextEvent == events->size())
+            return;
+        auto history = savesChanged ? std::make_shared<const SaveManager>(saves) : last.saves;
+        keyframes->push_back({ offset, events->size(), state, std::move(history) });
+        savesChanged = false;
+    }
+
+    // Live play stops at `tick` (e.g. while a replay is watched) and picks
+    // up again at the resume tick, with the gap left out of the recording.
+    void pause(unsigned long long tick) {
+        pausedAt = (uint32_t)(tick - startTick);
+    }
+
+    void resume(unsigned long long tick) {
+        startTick = tick - pausedAt;
     }
 
+    // A streamed run dropped here ends at its last input, not at the idle
+    // time before it was dropped.
     void clear() {
-        while (!(replayQueue.empty()))
-        replayQueue.pop();
+        writer.reset();
+        begin(0, 0, GameState());
     }
 
-    bool next(GameState& state) {
-        if (replayQueue.empty()) return false;
-        state = replayQueue.front();
-        replayQueue.pop();
+    // Everything recorded up to `tick`.
+    Replay copy(unsigned long long tick) const {
+        Replay r;
+        r.levelID = levelID;
+        r.events = events;
+        r.keyframes = keyframes;
+        r.eventCount = events->size();
+        r.keyframeCount = keyframes->size();
+        r.length = (uint32_t)(tick - startTick);
+        return r;
+    }
+};
+
+// Plays back a run archived by streamTo() on `level`, freshly built for the
+// file's level id. Only the start state is kept as a keyframe, so seeking
+// backwards re-simulates from the beginning.
+inline Replay replayFromFile(std::shared_ptr<const ReplayFile> file, const Level& level) {
+    GameState start = file->start();
+    start.level = level;
+
+    Replay r;
+    r.levelID = (int)file->header().levelID;
+    r.keyframes = std::make_shared<const std::vector<ReplayKeyframe>>(
+        std::vector<ReplayKeyframe>{ { 0, 0, start, std::make_shared<const SaveManager>() } });
+    r.keyframeCount = 1;
+    r.eventCount = file->eventCount();
+    r.length = file->length();
+    r.file = std::move(file);
+    return r;
+}
+
+// Re-simulates a Replay, level included, at an adjustable speed.
+class ReplayPlayer {
+    Replay replay;
+    GameState state;
+    SaveManager saves;
+    size_t nextEvent = 0;
+    uint32_t tick = 0;
+    double speed = 1;
+    double pendingSteps = 0;
+
+    void restore(const ReplayKeyframe& k) {
+        state = k.state;
+        saves = *k.saves;
+        nextEvent = k.nextEvent;
+        tick = k.tick;
+    }
+
+    // Applies the inputs stamped with the current tick that have not been
+    // applied yet, leaving the player where live play had it for that tick.
+    void applyEvents(const PhysicsConfig& config) {
+        const ReplayEvent* events = replay.file ? replay.file->events() : replay.events->data();
+        while (nextEvent < replay.eventCount && events[nextEvent].tick <= tick) {
+            uint8_t inputs = events[nextEvent++].inputs;
+            applyInput(state.player, state.level, config, inputs);
+            if (inputs & REPLAY_SAVE) saves.save(state);
+            if (inputs & REPLAY_UNDO) saves.undo(state);
+        }
+    }
+
+public:
+    static constexpr double MAX_SPEED = 8;
+
+    ReplayPlayer() = default;
+    explicit ReplayPlayer(Replay r) : replay(std::move(r)) {
+        if (replay.keyframeCount > 0) restore((*replay.keyframes)[0]);
+    }
+
+    const GameState& current() const { return state; }
+    uint32_t position() const { return tick; }
+    uint32_t length() const { return replay.length; }
+    bool finished() const { return tick >= replay.length; }
+
+    double getSpeed() const { return speed; }
+
+    // Replay ticks per simulation tick; 0 pauses playback.
+    void setSpeed(double ticksPerTick) {
+        speed = std::max(0.0, std::min(ticksPerTick, MAX_SPEED));
+    }
+
+    // Advances one replay tick; returns false once the recording is exhausted.
+    bool step(const PhysicsConfig& config) {
+        if (finished()) return false;
+        applyEvents(config);
+        stepPhysics(state.player, state.level, config);
+        tick++;
+        applyEvents(config);
         return true;
     }
 
-    std::queue<GameState> copy() {
-        return replayQueue;
+    // Advances by one simulation tick's worth of replay at the current speed.
+    void advance(const PhysicsConfig& config) {
+        pendingSteps += speed;
+        while (pendingSteps >= 1 && step(config)) pendingSteps -= 1;
+    }
+
+    // Jumps to `target` (clamped to the recording): restores the last
+    // keyframe at or before it and re-simulates the remainder.
+    void seek(const PhysicsConfig& config, uint32_t target) {
+        if (replay.keyframeCount == 0) return;
+        target = std::min(target, replay.length);
+
+        auto first = replay.keyframes->begin();
+        auto last = first + replay.keyframeCount;
+        auto k = std::upper_bound(first, last, target,
+            [](uint32_t t, const ReplayKeyframe& key) { return t < key.tick; });
+        // Stepping forward from where we are is cheaper than the keyframe.
+        if (target < tick || (k - 1)->tick > tick) restore(*(k - 1));
+
+        while (tick < target) step(config);
+        pendingSteps = 0;
     }
 };
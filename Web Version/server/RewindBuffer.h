@@ -0,0 +1,133 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "GameState.h"
+#include "Physics.h"
+
+// Always-on history of the last REWIND_CAPACITY ticks of a session, for
+// rewinding. Most ticks cost one byte:
+//
+//   bits 0-1  dx + 1 (-1..1); 3 = full state stored as a keyframe
+//   bits 2-4  dy + 3 (-3..3)
+//   bit  5    grounded
+//   bits 6-7  vy: VY_ZERO, VY_JUMP (jump then gravity), VY_FALL (previous
+//             plus gravity, capped) or VY_SAME
+//
+// Velocities are rebuilt with the same operations stepPhysics uses, so the
+// decoded state is bit-identical. Anything else (a teleport, an undo, a
+// changed level) and every REWIND_KEYFRAME_INTERVAL-th tick is stored in
+// full; the level is copy-on-write, so a full state is still small.
+
+const size_t REWIND_CAPACITY = 1200;        // 60 s at the default 20 ticks/s
+const size_t REWIND_KEYFRAME_INTERVAL = 64;
+
+class RewindBuffer {
+    enum : uint8_t {
+        CODE_KEYFRAME = 3,
+        VY_ZERO = 0,
+        VY_JUMP = 1,
+        VY_FALL = 2,
+        VY_SAME = 3,
+    };
+
+    struct Keyframe {
+        uint64_t index;
+        GameState state;
+    };
+
+    std::vector<uint8_t> codes;         // entry i lives at codes[i % size]
+    std::deque<Keyframe> keyframes;     // oldest first; front is the oldest entry
+    uint64_t next = 0;                  // index of the next entry
+    GameState last;                     // newest entry
+
+    static Scalar fall(Scalar vy, const PhysicsConfig& config) {
+        vy += config.gravity;
+        if (vy > config.maxFall) vy = config.maxFall;
+        return vy;
+    }
+
+    static bool encode(const GameState& prev, const GameState& cur, const PhysicsConfig& config, uint8_t& code) {
+        int dx = cur.player.x - prev.player.x;
+        int dy = cur.player.y - prev.player.y;
+        if (dx < -1 || dx > 1 || dy < -3 || dy > 3) return false;
+        if (cur.level.revision() != prev.level.revision()) return false;
+
+        uint8_t vy;
+        if (cur.player.vy == Scalar(0)) vy = VY_ZERO;
+        else if (cur.player.vy == fall(config.jump, config)) vy = VY_JUMP;
+        else if (cur.player.vy == fall(prev.player.vy, config)) vy = VY_FALL;
+        else if (cur.player.vy == prev.player.vy) vy = VY_SAME;
+        else return false;
+
+        code = (uint8_t)((dx + 1) | ((dy + 3) << 2) | (cur.player.grounded ? 0x20 : 0) | (vy << 6));
+        return true;
+    }
+
+    static void decode(GameState& state, uint8_t code, const PhysicsConfig& config) {
+        state.player.x += (code & 3) - 1;
+        state.player.y += ((code >> 2) & 7) - 3;
+        state.player.grounded = (code & 0x20) != 0;
+        switch (code >> 6) {
+            case VY_ZERO: state.player.vy = Scalar(0); break;
+            case VY_JUMP: state.player.vy = fall(config.jump, config); break;
+            case VY_FALL: state.player.vy = fall(state.player.vy, config); break;
+            default: break;
+        }
+    }
+
+public:
+    explicit RewindBuffer(size_t capacity = REWIND_CAPACITY) : codes(capacity) {}
+
+    // Forgets everything and starts over from `state`.
+    void reset(const GameState& state) {
+        keyframes.clear();
+        keyframes.push_back({ 0, state });
+        codes[0] = CODE_KEYFRAME;
+        last = state;
+        next = 1;
+    }
+
+    void record(const GameState& state, const PhysicsConfig& config) {
+        // Keep the window inside the ring; it shrinks a keyframe at a time.
+        while (!keyframes.empty() && next - keyframes.front().index >= codes.size())
+            keyframes.pop_front();
+
+        uint8_t code;
+        if (keyframes.empty() || next % REWIND_KEYFRAME_INTERVAL == 0 || !encode(last, state, config, code)) {
+            code = CODE_KEYFRAME;
+            keyframes.push_back({ next, state });
+        }
+        codes[next % codes.size()] = code;
+        last = state;
+        next++;
+    }
+
+    bool empty() const { return keyframes.empty(); }
+    uint64_t oldest() const { return keyframes.front().index; }
+    uint64_t newest() const { return next - 1; }
+
+    // State recorded at `index`, oldest() <= index <= newest().
+    GameState stateAt(uint64_t index, const PhysicsConfig& config) const {
+        size_t k = keyframes.size() - 1;
+        while (keyframes[k].index > index) k--;
+
+        GameState state = keyframes[k].state;
+        for (uint64_t i = keyframes[k].index + 1; i <= index; i++)
+            decode(state, codes[i % codes.size()], config);
+        return state;
+    }
+
+    // Drops every entry after `index`, which becomes the newest.
+    void truncate(uint64_t index, const PhysicsConfig& config) {
+        while (keyframes.back().index > index) keyframes.pop_back();
+        last = stateAt(index, config);
+        next = index + 1;
+    }
+
+    // Bytes held, not counting level storage shared with the live game.
+    size_t memoryUsage() const {
+        return codes.size() + keyframes.size() * sizeof(Keyframe);
+    }
+};
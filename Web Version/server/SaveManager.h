@@ -1,17 +1,22 @@
 #pragma once
-#include <stack>
+#include <cstddef>
 #include "GameState.h"
+#include "RingStack.h"
+
+// Undo history is capped at SAVE_DEPTH saves; older ones are overwritten.
+const size_t SAVE_DEPTH = 32;
 
 class SaveManager {
-    std::stack<GameState> saves;
+    RingStack<GameState> saves;
 public:
+    explicit SaveManager(size_t depth = SAVE_DEPTH) : saves(depth) {}
+
     void save(const GameState& state) {
         saves.push(state);
     }
 
     void clear() {
-        while (!(saves.empty()))
-        saves.pop();
+        saves.clear();
     }
 
     bool undo(GameState& state) {
@@ -21,4 +26,9 @@ public:
         state = saves.top();
         return true;
     }
+
+    // Saves lost to the depth cap.
+    unsigned long long dropped() const {
+        return saves.dropped();
+    }
 };
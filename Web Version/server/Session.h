@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "GameState.h"
+#include "Level.h"
+#include "SaveManager.h"
+#include "ReplayManager.h"
+#include "RewindBuffer.h"
+#include "TutorialManager.h"
+#include "StateSnapshot.h"
+
+// Everything one connected player owns. All game fields are guarded by
+// `mutex`; the published snapshot has its own lock so readers never wait
+// on the simulation.
+struct Session {
+    using clock = std::chrono::steady_clock;
+
+    std::mutex mutex;
+    GameState gameState;
+    SaveManager saveManager;
+    ReplayManager replayManager;
+    TutorialManager tutorialManager;
+    ReplayPlayer replayPlayer;
+    double replaySpeed = 1;
+    bool replayIsArchive = false;   // playing a file, not this session's run
+    GameState liveState;            // where live play resumes after an archived run
+    bool isReplaying = false;
+    RewindBuffer rewind;
+    bool isRewinding = false;
+    uint64_t rewindPos = 0;
+    double rewindPending = 0;
+    int currentLevelID = 1;
+    unsigned long long levelVersion = 0;
+    unsigned long long tick = 0;
+
+    std::mutex snapshotMutex;
+    std::condition_variable snapshotChanged;
+    std::shared_ptr<const StateSnapshot> snapshot;
+
+    std::atomic<clock::rep> lastSeen;
+
+    // `level` is normally a shared template; copying it shares its storage.
+    explicit Session(const Level& level) {
+        gameState.level = level;
+        touch();
+    }
+
+    void touch() {
+        lastSeen = clock::now().time_since_epoch().count();
+    }
+
+    clock::time_point lastSeenTime() const {
+        return clock::time_point(clock::duration(lastSeen.load()));
+    }
+
+    // Caller must hold mutex.
+    void releaseHistory() {
+        replayManager.clear();
+        saveManager.clear();
+        replayPlayer = ReplayPlayer();
+        isReplaying = false;
+        liveState = GameState();
+        rewind = RewindBuffer();
+        isRewinding = false;
+    }
+
+    std::shared_ptr<const StateSnapshot> getSnapshot() {
+        std::lock_guard<std::mutex> lock(snapshotMutex);
+        return snapshot;
+    }
+
+    void setSnapshot(std::shared_ptr<const StateSnapshot> s) {
+        {
+            std::lock_guard<std::mutex> lock(snapshotMutex);
+            snapshot = std::move(s);
+        }
+        snapshotChanged.notify_all();
+    }
+
+    // Blocks until a snapshot other than `last` is published or `timeout`
+    // passes, and returns whatever is current.
+    std::shared_ptr<const StateSnapshot> waitForSnapshot(const std::shared_ptr<const StateSnapshot>& last,
+                                                         clock::duration timeout) {
+        std::unique_lock<std::mutex> lock(snapshotMutex);
+        snapshotChanged.wait_for(lock, timeout, [&] { return snapshot != last; });
+        return snapshot;
+    }
+};
+
+// Registry of live sessions keyed by an opaque random token. The table is
+// split into shards, each with its own lock, so lookups for different
+// players rarely touch the same mutex.
+class SessionManager {
+public:
+    static const int SHARD_COUNT = 16;
+
+    struct Metrics {
+        size_t liveSessions;
+        unsigned long long created;
+        unsigned long long evicted;
+        unsigned long long lookups;
+        unsigned long long contendedLookups;
+    };
+
+private:
+    struct Shard {
+        std::shared_mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<Session>> sessions;
+    };
+
+    Shard shards[SHARD_COUNT];
+
+    std::mutex rngMutex;
+    std::mt19937_64 rng{std::random_device{}()};
+
+    std::atomic<size_t> liveSessions{0};
+    std::atomic<unsigned long long> created{0};
+    std::atomic<unsigned long long> evicted{0};
+    std::atomic<unsigned long long> lookups{0};
+    std::atomic<unsigned long long> contendedLookups{0};
+
+    Shard& shardFor(const std::string& token) {
+        return shards[std::hash<std::string>{}(token) % SHARD_COUNT];
+    }
+
+    std::string newToken() {
+        static const char* hex = "0123456789abcdef";
+        std::lock_guard<std::mutex> lock(rngMutex);
+        std::string token;
+        for (int i = 0; i < 2; i++) {
+            unsigned long long bits = rng();
+            for (int j = 0; j < 16; j++) {
+                token += hex[bits & 0xF];
+                bits >>= 4;
+            }
+        }
+        return token;
+    }
+
+public:
+    std::shared_ptr<Session> find(const std::string& token) {
+        Shard& shard = shardFor(token);
+        lookups++;
+
+        std::shared_lock<std::shared_mutex> lock(shard.mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            contendedLookups++;
+            lock.lock();
+        }
+
+        auto it = shard.sessions.find(token);
+        if (it == shard.sessions.end()) return nullptr;
+        it->second->touch();
+        return it->second;
+    }
+
+    // Creates a session on `level` and returns its token through `token`.
+    std::shared_ptr<Session> create(const Level& level, std::string& token) {
+        auto session = std::make_shared<Session>(level);
+        while (true) {
+            token = newToken();
+            Shard& shard = shardFor(token);
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            if (shard.sessions.count(token)) continue;
+            shard.sessions[token] = session;
+            break;
+        }
+        liveSessions++;
+        created++;
+        return session;
+    }
+
+    std::vector<std::shared_ptr<Session>> all() {
+        std::vector<std::shared_ptr<Session>> result;
+        result.reserve(liveSessions);
+        for (Shard& shard : shards) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            for (auto& entry : shard.sessions) result.push_back(entry.second);
+        }
+        return result;
+    }
+
+    // Drops sessions idle for longer than `ttl` and releases their replay and
+    // save history right away, even if a request still holds a reference.
+    size_t evictIdle(std::chrono::steady_clock::duration ttl) {
+        auto cutoff = Session::clock::now() - ttl;
+        std::vector<std::shared_ptr<Session>> removed;
+
+        for (Shard& shard : shards) {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            for (auto it = shard.sessions.begin(); it != shard.sessions.end();) {
+                if (it->second->lastSeenTime() < cutoff) {
+                    removed.push_back(it->second);
+                    it = shard.sessions.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        for (auto& session : removed) {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            session->releaseHistory();
+        }
+
+        liveSessions -= removed.size();
+        evicted += removed.size();
+        return removed.size();
+    }
+
+    size_t size() const { return liveSessions; }
+
+    Metrics metrics() const {
+        return { liveSessions, created, evicted, lookups, contendedLookups };
+    }
+};
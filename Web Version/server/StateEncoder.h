@@ -0,0 +1,93 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "json.hpp"
+#include "Camera.h"
+#include "Level.h"
+#include "StateSnapshot.h"
+
+// JSON encoding of /state and /events payloads.
+
+// Clients only get the tiles inside their view, at most this many cells on
+// a side, so a response costs the same on any size of level.
+const int MAX_VIEW_SIDE = 256;
+
+// Serialized JSON array of the grid rows inside a window.
+inline std::shared_ptr<const std::string> buildGrid(const Level& level, int left, int top, int width, int height) {
+    nlohmann::json grid = nlohmann::json::array();
+    for (int y = top; y < top + height; y++) {
+        std::string row = "";
+        for (int x = left; x < left + width; x++) {
+            if (level.isGoal(x, y)) row += "G";
+            else if (level.isDoor(x, y)) row += "D";
+            else row += level.getTile(x, y);
+        }
+        grid.push_back(row);
+    }
+    return std::make_shared<const std::string>(grid.dump());
+}
+
+// Which parts of a snapshot a client holding (sinceTick, levelVersion) is
+// missing. A client on another level version, or one that sends no tick,
+// gets everything including the grid.
+struct StateDelta {
+    bool full;
+    bool player;
+    bool messages;
+    bool grid;      // tiles inside the view; see placeView
+};
+
+inline StateDelta diffState(const StateSnapshot& snap, long long sinceTick, unsigned long long levelVersion) {
+    bool full = sinceTick < 0 || levelVersion != snap.levelVersion
+        || (unsigned long long)sinceTick > snap.tick;
+    unsigned long long since = full ? 0 : (unsigned long long)sinceTick;
+    return { full, full || snap.playerTick > since, full || snap.messageTick > since, full };
+}
+
+// Moves the client's view (`camera`, holding the window it has) after the
+// player. A full update centres it; otherwise it only moves once the player
+// nears its edge, and the tiles are resent just then.
+inline void placeView(const StateSnapshot& snap, StateDelta& delta, Camera& camera) {
+    if (delta.full) camera.follow(snap.level, snap.player.x, snap.player.y);
+    else if (camera.track(snap.level, snap.player.x, snap.player.y)) delta.grid = true;
+}
+
+// Whether the view is the whole level, whose grids a snapshot may hold ready.
+inline bool wholeLevel(const StateSnapshot& snap, const Camera& camera) {
+    return camera.viewWidth == snap.width && camera.viewHeight == snap.height;
+}
+
+inline std::string encodeState(const StateSnapshot& snap, const StateDelta& delta, const Camera& camera) {
+    nlohmann::json j;
+    j["tick"] = snap.tick;
+    j["level"] = snap.levelVersion;
+    j["levelId"] = snap.levelID;
+
+    if (delta.player) {
+        j["player"] = { {"x", snap.player.x}, {"y", snap.player.y} };
+    }
+
+    if (delta.messages) {
+        j["tutorial"] = snap.tutorial;
+        j["goalMessage"] = snap.goalMessage;
+        j["choices"] = nlohmann::json::array();
+        for (auto& opt : snap.choices) {
+            j["choices"].push_back({ {"id", opt.first}, {"text", opt.second} });
+        }
+    }
+
+    if (!delta.grid) return j.dump();
+
+    j["width"] = snap.width;
+    j["height"] = snap.height;
+    j["view"] = { {"x", camera.x}, {"y", camera.y}, {"width", camera.viewWidth}, {"height", camera.viewHeight} };
+
+    // Splice the pre-serialized grid in rather than re-parsing it.
+    std::string body = j.dump();
+    body.pop_back();
+    body += ",\"grid\":";
+    if (snap.grid && wholeLevel(snap, camera)) body += *snap.grid;
+    else body += *buildGrid(snap.level, camera.x, camera.y, camera.viewWidth, camera.viewHeight);
+    body += "}";
+    return body;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Player.h"
+#include "Level.h"
+
+// Read-only view of a session after a completed tick. Each group of fields
+// remembers the tick it last changed on, so /state can send a client only
+// what is newer than the tick it already has.
+struct StateSnapshot {
+    unsigned long long tick = 0;
+    int levelID = 0;
+
+    // Changes whenever a level is (re)loaded; the grid is only resent then.
+    unsigned long long levelVersion = 0;
+    uint64_t levelRevision = 0;                      // Level::revision() of the grid
+    int width = 0;
+    int height = 0;
+    Level level;                                     // shares the session's storage; views are cut from it
+
+    // The whole grid pre-encoded, for levels no bigger than one view
+    // (MAX_VIEW_SIDE); null for larger ones.
+    std::shared_ptr<const std::string> grid;         // serialized JSON array of rows
+    std::shared_ptr<const std::string> packedGrid;   // binary form, see BinaryState.h
+
+    Player player;
+    unsigned long long playerTick = 0;
+
+    std::string tutorial;
+    std::string goalMessage;
+    std::vector<std::pair<int, std::string>> choices;
+    unsigned long long messageTick = 0;
+};
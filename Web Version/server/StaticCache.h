@@ -0,0 +1,185 @@
+#pragma once
+#include <sys/stat.h>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "httplib.h"
+
+#ifdef STATIC_CACHE_GZIP
+#include <zlib.h>
+#endif
+
+// Static files loaded into memory once at startup and served with ETag /
+// Last-Modified validation. Build with -DSTATIC_CACHE_GZIP -lz to also keep
+// a pre-compressed gzip copy of each text file.
+class StaticCache {
+    struct Entry {
+        std::string filePath;
+        std::string contentType;
+        std::string cacheControl;
+        std::string body;
+        std::string gzipBody;
+        std::string etag;
+        std::string lastModified;
+        time_t mtime = 0;
+    };
+
+    std::mutex mutex;
+    std::map<std::string, std::shared_ptr<const Entry>> entries;
+
+    static bool readFile(const std::string& path, std::string& out, time_t& mtime) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return false;
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        out.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        mtime = st.st_mtime;
+        return true;
+    }
+
+    static std::string makeEtag(const std::string& body) {
+        // FNV-1a; only needs to change when the content does.
+        uint64_t hash = 1469598103934665603ULL;
+        for (unsigned char c : body) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        char buf[24];
+        snprintf(buf, sizeof(buf), "\"%016llx\"", (unsigned long long)hash);
+        return buf;
+    }
+
+    static std::string httpDate(time_t t) {
+        char buf[64];
+        struct tm tm = *gmtime(&t);
+        strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        return buf;
+    }
+
+    static std::string gzip(const std::string& body) {
+#ifdef STATIC_CACHE_GZIP
+        z_stream zs = {};
+        if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            return "";
+        std::string out(deflateBound(&zs, body.size()), '\0');
+        zs.next_in = (Bytef*)body.data();
+        zs.avail_in = (uInt)body.size();
+        zs.next_out = (Bytef*)&out[0];
+        zs.avail_out = (uInt)out.size();
+        int ret = deflate(&zs, Z_FINISH);
+        out.resize(zs.total_out);
+        deflateEnd(&zs);
+        if (ret != Z_STREAM_END || out.size() >= body.size()) return "";
+        return out;
+#else
+        (void)body;
+        return "";
+#endif
+    }
+
+    static bool isCompressible(const std::string& contentType) {
+        return contentType.rfind("text/", 0) == 0 || contentType == "application/javascript"
+            || contentType == "application/json";
+    }
+
+    static std::shared_ptr<const Entry> build(const std::string& filePath, const std::string& contentType,
+                                              const std::string& cacheControl) {
+        auto entry = std::make_shared<Entry>();
+        if (!readFile(filePath, entry->body, entry->mtime)) return nullptr;
+        entry->filePath = filePath;
+        entry->contentType = contentType;
+        entry->cacheControl = cacheControl;
+        entry->etag = makeEtag(entry->body);
+        entry->lastModified = httpDate(entry->mtime);
+        if (isCompressible(contentType)) entry->gzipBody = gzip(entry->body);
+        return entry;
+    }
+
+    std::shared_ptr<const Entry> find(const std::string& urlPath) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(urlPath);
+        return it == entries.end() ? nullptr : it->second;
+    }
+
+public:
+    static std::string contentTypeFor(const std::string& path) {
+        auto dot = path.rfind('.');
+        std::string ext = dot == std::string::npos ? "" : path.substr(dot + 1);
+        if (ext == "html") return "text/html";
+        if (ext == "js") return "application/javascript";
+        if (ext == "css") return "text/css";
+        if (ext == "json") return "application/json";
+        if (ext == "png") return "image/png";
+        return "application/octet-stream";
+    }
+
+    // Loads `filePath` and serves it at `urlPath`. Returns false if the file
+    // could not be read.
+    bool add(const std::string& urlPath, const std::string& filePath, const std::string& cacheControl) {
+        auto entry = build(filePath, contentTypeFor(filePath), cacheControl);
+        if (!entry) return false;
+        std::lock_guard<std::mutex> lock(mutex);
+        entries[urlPath] = entry;
+        return true;
+    }
+
+    // Re-reads any file whose modification time changed; used in dev mode.
+    size_t reloadChanged() {
+        std::vector<std::pair<std::string, std::shared_ptr<const Entry>>> current;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current.assign(entries.begin(), entries.end());
+        }
+
+        size_t reloaded = 0;
+        for (auto& item : current) {
+            struct stat st;
+            if (stat(item.second->filePath.c_str(), &st) != 0 || st.st_mtime == item.second->mtime) continue;
+
+            auto entry = build(item.second->filePath, item.second->contentType, item.second->cacheControl);
+            if (!entry) continue;
+            std::lock_guard<std::mutex> lock(mutex);
+            entries[item.first] = entry;
+            reloaded++;
+        }
+        return reloaded;
+    }
+
+    // Fills `res` for `urlPath`; returns false if nothing is cached there.
+    bool serve(const std::string& urlPath, const httplib::Request& req, httplib::Response& res) {
+        auto entry = find(urlPath);
+        if (!entry) return false;
+
+        bool useGzip = !entry->gzipBody.empty()
+            && req.get_header_value("Accept-Encoding").find("gzip") != std::string::npos;
+        std::string etag = entry->etag;
+        if (useGzip) etag.insert(etag.size() - 1, "-gz");
+
+        res.set_header("ETag", etag);
+        res.set_header("Last-Modified", entry->lastModified);
+        res.set_header("Cache-Control", entry->cacheControl);
+        if (!entry->gzipBody.empty()) res.set_header("Vary", "Accept-Encoding");
+
+        bool notModified = req.has_header("If-None-Match")
+            ? req.get_header_value("If-None-Match").find(etag) != std::string::npos
+            : req.get_header_value("If-Modified-Since") == entry->lastModified;
+        if (notModified) {
+            res.status = 304;
+            return true;
+        }
+
+        if (useGzip) {
+            res.set_header("Content-Encoding", "gzip");
+            res.set_content(entry->gzipBody, entry->contentType);
+        } else {
+            res.set_content(entry->body, entry->contentType);
+        }
+        return true;
+    }
+};
@@ -13,10 +13,16 @@ echo.
 
 REM Compile
 REM -std=c++11: Standard C++
+REM -I../../Core: Shared simulation core (Player, Level, physics, RingStack)
 REM -lws2_32 -lwsock32: Links Windows Socket Libraries
 REM -D_WIN32_WINNT=0x0A00: Sets Windows version to Win10 (Fixes WSAPoll/getaddrinfo errors)
 REM -static: Prevents missing DLL errors
-g++ main.cpp Player.h GameState.h SaveManager.h ReplayManager.h DecisionTree.h TutorialManager.h -o server.exe -std=c++17 -lws2_32
+REM Optional: add -DSTATIC_CACHE_GZIP -lz to serve pre-gzipped index.html/script.js
+REM Run "server.exe --dev" to reload edited static files without restarting
+REM Run "server.exe --replays replays" to archive every level run to disk
+REM Levels are read from levels\<n>.lvl and compiled to .lvb on first start;
+REM "server.exe --levels DIR" reads another directory
+g++ main.cpp -I../../Core GameState.h SaveManager.h ReplayManager.h ReplayFile.h RewindBuffer.h DecisionTree.h TutorialManager.h StateSnapshot.h Session.h StateEncoder.h BinaryState.h StaticCache.h -o server.exe -std=c++17 -lws2_32
 
 
 echo.
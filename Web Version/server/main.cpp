@@ -1,128 +1,316 @@
 #define _WIN32_WINNT 0x0A00 // Fix for Windows 10 networking
 
+// httplib's default backlog of 5 drops SYNs when many players connect at
+// once, costing each of them a one-second retransmit.
+#ifndef CPPHTTPLIB_LISTEN_BACKLOG
+#define CPPHTTPLIB_LISTEN_BACKLOG 512
+#endif
 #include "httplib.h"
 #include "json.hpp"
 
 #include "Player.h"
 #include "GameState.h"
 #include "Level.h"
+#include "LevelFile.h"
+#include "Physics.h"
 #include "SaveManager.h"
 #include "ReplayManager.h"
+#include "ReplayFile.h"
+#include "RewindBuffer.h"
 #include "TutorialManager.h"
 #include "DecisionTree.h"
+#include "Session.h"
+#include "StateEncoder.h"
+#include "BinaryState.h"
+#include "StaticCache.h"
 
 #include <iostream>
-#include <queue>
-#include <cmath>
-#include <fstream>
 #include <string>
 #include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <filesystem>
+#include <ctime>
+#include <map>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 using json = nlohmann::json;
 
-std::mutex gameMutex;
-GameState gameState;
-SaveManager saveManager;
-ReplayManager replayManager;
-TutorialManager tutorialManager;
+SessionManager sessions;
 DecisionTree decisionTree;
+StringTable messageStrings;
+StaticCache staticFiles;
 
-std::queue<GameState> replayBackup;
-bool isReplaying = false;
-
-const double GRAVITY = 0.4;
-const double JUMP = -2.0;
-const double MAX_FALL = 2.0;
+const PhysicsConfig PHYSICS;   // gravity 0.4, jump -2.0, max fall 2.0
 
+// Size and spawn used for a level id with no level file.
 const int WIDTH = 50;
 const int HEIGHT = 20;
-
-Level level(WIDTH, HEIGHT);
-int currentLevelID = 1;
+const int SPAWN_X = 10;
+const int SPAWN_Y = 19;
+
+// One immutable copy of each level, shared by every session on it. A
+// session's level starts as a copy of its template, which shares all of its
+// storage (Level is copy-on-write), so a session holds no grid of its own
+// until it changes a tile. The serialized grids are shared the same way.
+struct LevelTemplate {
+    Level level;
+    int spawnX = SPAWN_X;
+    int spawnY = SPAWN_Y;
+    uint64_t levelHash = 0;     // LevelFileHeader::contentHash; 0 for the fallback
+    std::shared_ptr<const std::string> grid;
+    std::shared_ptr<const std::string> packedGrid;
+};
+
+// Built from --levels DIR (default "levels", here or beside the executable;
+// see LevelFile.h) at startup and read-only afterwards; ids without a file
+// get the empty fallback.
+std::string levelDir = "levels";
+std::map<int, LevelTemplate> levelTemplates;
+LevelTemplate fallbackLevel;
+
+const char* SESSION_COOKIE = "sid";
+const char* SESSION_HEADER = "X-Session-Id";
+
+// Simulation runs on its own thread at a fixed rate; /state only reads the
+// snapshot published after the last completed tick.
+const int DEFAULT_TICK_RATE = 20;   // ticks per second
+const int MAX_STEPS_PER_FRAME = 5;  // catch-up cap after a stall
+
+// Worker threads serving HTTP requests (--threads). Each open /events
+// stream holds one for as long as it is open, so at most half of them may
+// be streams; further streams are refused and those clients poll /state.
+const int DEFAULT_HTTP_THREADS = 64;
+size_t maxEventStreams = DEFAULT_HTTP_THREADS / 2;
+std::atomic<size_t> openEventStreams{0};
+
+// Idle /events streams send a comment line this often so dead connections
+// are noticed and proxies keep the stream open.
+const std::chrono::seconds EVENT_HEARTBEAT(15);
+
+// Pages revalidate with their ETag on every load; images are cached long-term.
+const char* PAGE_CACHE_CONTROL = "no-cache";
+const char* ASSET_CACHE_CONTROL = "public, max-age=31536000";
+
+// Sessions not seen for SESSION_TTL are dropped by the sweeper thread.
+const std::chrono::seconds SESSION_TTL(600);
+const std::chrono::seconds SWEEP_INTERVAL(30);
+
+// With --replays DIR every level run is streamed to DIR/<start>-<n>.rpl.
+std::string replayDir;
+const long long SERVER_START = (long long)std::time(nullptr);
+std::atomic<unsigned long long> nextReplayFile{1};
+
+std::atomic<bool> running{true};
+std::atomic<unsigned long long> nextLevelVersion{1};
 
 // ------------------ Utility ------------------
-std::string readFile(const std::string &filename) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) return "";
-    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-}
-
-void loadLevel(int id) {
-    currentLevelID = id;
-    level.resetGrid();
-    replayManager.clear();
-    saveManager.clear();
-
-    gameState.player.x = 10;
-    gameState.player.y = 19;
-    gameState.player.vy = 0;
-    gameState.player.grounded = true;
-
-    if (id == 1) {
-        level.createPlatform(16, 10, 10);
-        level.createPlatform(13, 22, 13);
-        level.addDoor(34, 12);
-        level.setGoal(-1,-1);
-    }
-    else if (id == 2) {
-        tutorialManager.isActive = false;
-        level.createPlatform(3,  15, 10);
-        level.createPlatform(5,  27, 6);
-        level.createPlatform(7,  36, 12);
-        level.createPlatform(10, 23, 13);
-        level.createPlatform(13, 10, 11);
-        level.createPlatform(16, 5, 5);
-        level.setGoal(15, 2);
-    }
-    else if (id == 3) {
-        tutorialManager.isActive = false;
-        level.createPlatform(3,  42, 5);
-        level.createPlatform(6,  35, 5);
-        level.createPlatform(8,  28, 5);
-        level.createPlatform(11, 21, 5);
-        level.createPlatform(14, 14, 5);
-        level.createPlatform(17, 7, 5);
-        level.setGoal(46, 2);
+void loadStaticFiles() {
+    if (!staticFiles.add("/", "index.html", PAGE_CACHE_CONTROL))
+        std::cout << "Warning: index.html missing.\n";
+    if (!staticFiles.add("/script.js", "script.js", PAGE_CACHE_CONTROL))
+        std::cout << "Warning: script.js missing.\n";
+
+    std::error_code ec;
+    size_t assets = 0;
+    for (auto& file : std::filesystem::directory_iterator("assets", ec)) {
+        if (!file.is_regular_file()) continue;
+        std::string name = file.path().filename().string();
+        if (staticFiles.add("/assets/" + name, "assets/" + name, ASSET_CACHE_CONTROL)) assets++;
     }
+    if (assets == 0) std::cout << "Warning: 'assets' folder not found.\n";
 }
 
-//physics
-void physics() {
-    if (!gameState.player.grounded) {
-        gameState.player.vy += GRAVITY;
-        if (gameState.player.vy > MAX_FALL) gameState.player.vy = MAX_FALL;
+std::string getCookie(const httplib::Request& req, const std::string& name) {
+    std::string cookies = req.get_header_value("Cookie");
+    size_t pos = 0;
+    while (pos < cookies.size()) {
+        size_t end = cookies.find(';', pos);
+        if (end == std::string::npos) end = cookies.size();
+        size_t start = cookies.find_first_not_of(' ', pos);
+        size_t eq = cookies.find('=', start);
+        if (eq < end && cookies.compare(start, eq - start, name) == 0)
+            return cookies.substr(eq + 1, end - eq - 1);
+        pos = end + 1;
     }
+    return "";
+}
 
-    int steps = int(fabs(gameState.player.vy) + 0.5);
-    int dir = (gameState.player.vy > 0) ? 1 : -1;
-
-    for (int i = 0; i < steps; i++) {
-        int newY = gameState.player.y + dir;
-        if (level.isBlocked(gameState.player.x, newY)) {
-            gameState.player.vy = 0;
-            if (dir > 0) gameState.player.grounded = true;
-            break;
-        } else {
-            gameState.player.y = newY;
+// The view a /state or /events client shows: vw and vh cells (at most
+// MAX_VIEW_SIDE, the default), with its top-left corner at the vx, vy it was
+// last sent. The server keeps no view per client; each request carries it.
+Camera requestView(const httplib::Request& req) {
+    auto param = [&](const char* name, int fallback, int low, int high) {
+        if (!req.has_param(name)) return fallback;
+        try {
+            return std::clamp(std::stoi(req.get_param_value(name)), low, high);
+        }
+        catch (...) {
+            return fallback;
         }
+    };
+    Camera camera(param("vw", MAX_VIEW_SIDE, 1, MAX_VIEW_SIDE), param("vh", MAX_VIEW_SIDE, 1, MAX_VIEW_SIDE));
+    camera.x = param("vx", 0, 0, MAX_LEVEL_SIDE);
+    camera.y = param("vy", 0, 0, MAX_LEVEL_SIDE);
+    return camera;
+}
+
+// Grids of a whole level are only worth keeping when a client can be sent
+// the whole level in one view; larger levels are encoded a view at a time.
+bool fitsView(const Level& level) {
+    return level.getWidth() <= MAX_VIEW_SIDE && level.getHeight() <= MAX_VIEW_SIDE;
+}
+
+void buildGrids(LevelTemplate& t) {
+    if (!fitsView(t.level)) return;
+    t.grid = buildGrid(t.level, 0, 0, t.level.getWidth(), t.level.getHeight());
+    t.packedGrid = packGrid(t.level, 0, 0, t.level.getWidth(), t.level.getHeight());
+}
+
+// Returns false if there is no level to play.
+bool loadLevelTemplates() {
+    std::vector<std::string> errors;
+    for (auto& entry : loadLevelPack(levelDir, errors)) {
+        LevelTemplate& t = levelTemplates[entry.first];
+        entry.second->load(t.level);
+        t.spawnX = entry.second->header().spawnX;
+        t.spawnY = entry.second->header().spawnY;
+        t.levelHash = entry.second->header().contentHash;
+        buildGrids(t);
     }
+    for (const std::string& error : errors) std::cout << "Warning: " << error << "\n";
+    std::cout << "Loaded " << levelTemplates.size() << " levels from " << levelDir << "\n";
 
-    if (level.isBlocked(gameState.player.x, gameState.player.y + 1)) {
-        gameState.player.grounded = true;
-        gameState.player.vy = 0;
-    } else {
-        gameState.player.grounded = false;
+    fallbackLevel.level = Level(WIDTH, HEIGHT);
+    buildGrids(fallbackLevel);
+    return !levelTemplates.empty();
+}
+
+const LevelTemplate& levelTemplate(int id) {
+    auto it = levelTemplates.find(id);
+    return it != levelTemplates.end() ? it->second : fallbackLevel;
+}
+
+// Streams the recording just begun to the --replays directory, if any.
+// Writes that fail are counted in /metrics.
+void streamReplay(Session& s) {
+    if (replayDir.empty()) return;
+    std::string path = replayDir + "/" + std::to_string(SERVER_START) + "-"
+        + std::to_string(nextReplayFile++) + ".rpl";
+    s.replayManager.streamTo(path, configHash(PHYSICS), levelTemplate(s.currentLevelID).levelHash);
+}
+
+void loadLevel(Session& s, int id) {
+    s.currentLevelID = id;
+    s.levelVersion = nextLevelVersion++;
+    s.saveManager.clear();
+
+    const LevelTemplate& t = levelTemplate(id);
+    s.gameState.level = t.level;
+    s.gameState.player.x = t.spawnX;
+    s.gameState.player.y = t.spawnY;
+    s.gameState.player.vy = Scalar(0);
+    s.gameState.player.grounded = true;
+    // The tutorial only runs on the first level.
+    if (id != 1) s.tutorialManager.isActive = false;
+
+    s.replayManager.begin(id, s.tick, s.gameState);
+    streamReplay(s);
+    s.rewind.reset(s.gameState);
+    s.isRewinding = false;
+}
+
+//physics
+void physics(Session& s) {
+    s.replayManager.keyframe(s.tick, s.gameState, s.saveManager);
+    s.replayManager.flushStream(s.tick);
+    stepPhysics(s.gameState.player, s.gameState.level, PHYSICS);
+    s.rewind.record(s.gameState, PHYSICS);
+}
+
+// Steps back through the rewind history, one tick per simulation tick at
+// the replay speed, until another input arrives or the history runs out.
+void startRewind(Session& s) {
+    if (s.rewind.empty() || s.rewind.newest() == s.rewind.oldest()) return;
+    s.rewindPos = s.rewind.newest();
+    s.rewindPending = 0;
+    s.gameState = s.rewind.stateAt(s.rewindPos, PHYSICS);
+    s.isRewinding = true;
+}
+
+// Resumes live play from the rewound state. The discarded future is gone
+// from the history, and recording starts afresh from here; `nextTick` is
+// the first tick whose physics will run live.
+void stopRewind(Session& s, unsigned long long nextTick) {
+    s.rewind.truncate(s.rewindPos, PHYSICS);
+    s.isRewinding = false;
+    s.replayManager.begin(s.currentLevelID, nextTick, s.gameState, s.saveManager);
+    streamReplay(s);
+}
+
+void rewindTick(Session& s) {
+    s.rewindPending += s.replaySpeed;
+    while (s.rewindPending >= 1 && s.rewindPos > s.rewind.oldest()) {
+        s.rewindPos--;
+        s.rewindPending -= 1;
     }
+    s.gameState = s.rewind.stateAt(s.rewindPos, PHYSICS);
+    if (s.rewindPos == s.rewind.oldest()) stopRewind(s, s.tick + 1);
+}
+
+// Switches the session to watching `replay`. A rewind in progress ends where
+// it is, and live play is paused from there until the replay ends. Caller
+// must hold s.mutex.
+void playReplay(Session& s, Replay replay, bool archive) {
+    if (s.isRewinding) stopRewind(s, s.tick);
+    s.replayManager.pause(s.tick);
+    if (archive) s.liveState = s.gameState;
+    s.replayPlayer = ReplayPlayer(std::move(replay));
+    s.replayPlayer.setSpeed(s.replaySpeed);
+    s.gameState = s.replayPlayer.current();
+    s.replayIsArchive = archive;
+    s.isReplaying = true;
+}
+
+// Replays the session's own recording from the start of the level, or from
+// where a rewind in progress leaves it.
+bool startReplay(Session& s) {
+    if (s.isRewinding) stopRewind(s, s.tick);
+    Replay replay = s.replayManager.copy(s.tick);
+    if (replay.length == 0) return false;
+    playReplay(s, std::move(replay), false);
+    return true;
 }
 
 //input
-void handleInput(const std::string& key, int choiceId = -1) {
-    if (isReplaying) return;
+void handleInput(Session& s, const std::string& key, int choiceId = -1) {
+    if (s.isReplaying) return;
+
+    // Any input ends a rewind where it is; "rewind" itself toggles it.
+    if (s.isRewinding) {
+        stopRewind(s, s.tick);
+        if (key == "rewind") return;
+    }
+    else if (key == "rewind") {
+        startRewind(s);
+        return;
+    }
 
     bool allowed = true;
-    if (tutorialManager.isActive) {
+    if (s.tutorialManager.isActive) {
         if (key == "left" || key == "right" || key == "up") {
-            allowed = tutorialManager.checkProgress(key);
+            allowed = s.tutorialManager.checkProgress(key);
         }
     }
     if (!allowed) return;
@@ -130,122 +318,500 @@ void handleInput(const std::string& key, int choiceId = -1) {
     if (key == "choose" && choiceId != -1) {
         int nextLevel = decisionTree.getTargetLevel(choiceId);
         if (nextLevel != -1) {
-            loadLevel(nextLevel);
+            loadLevel(s, nextLevel);
             return;
         }
     }
 
-    if (key == "left" && !level.isBlocked(gameState.player.x - 1, gameState.player.y)) {
-        gameState.player.x--;
+    uint8_t recorded = INPUT_NONE;
+    if (key == "left") {
+        recorded = INPUT_LEFT;
     }
-    else if (key == "right" && !level.isBlocked(gameState.player.x + 1, gameState.player.y)) {
-        gameState.player.x++;
+    else if (key == "right") {
+        recorded = INPUT_RIGHT;
     }
-    else if (key == "up" && gameState.player.grounded) {
-        gameState.player.vy = JUMP;
-        gameState.player.grounded = false;
+    else if (key == "up") {
+        recorded = INPUT_JUMP;
     }
     else if (key == "save") {
-        saveManager.save(gameState);
+        s.saveManager.save(s.gameState);
+        recorded = REPLAY_SAVE;
     }
     else if (key == "undo") {
-        saveManager.undo(gameState);
+        s.saveManager.undo(s.gameState);
+        recorded = REPLAY_UNDO;
     }
     else if (key == "replay") {
-        replayBackup = replayManager.copy();
-        isReplaying = true;
+        startReplay(s);
     }
 
     else if (key == "reset")
-        loadLevel(1);
+        loadLevel(s, 1);
+
+    // Movement is applied now and recorded against the tick it precedes,
+    // which is where playback re-applies it.
+    applyInput(s.gameState.player, s.gameState.level, PHYSICS, recorded);
+    if (recorded != INPUT_NONE) s.replayManager.record(s.tick, recorded);
+}
+
+// Re-simulates this tick's share of the replay in place of the live
+// physics. The session's own replay ends in the state it was started from,
+// so play resumes seamlessly on the next tick; after an archived run the
+// state live play was paused in is put back.
+void replayTick(Session& s) {
+    s.replayPlayer.advance(PHYSICS);
+    s.gameState = s.replayPlayer.current();
+    if (s.replayPlayer.finished()) {
+        if (s.replayIsArchive) {
+            s.gameState = s.liveState;
+            s.liveState = GameState();
+        }
+        s.replayManager.resume(s.tick + 1);
+        s.replayPlayer = ReplayPlayer();
+        s.isReplaying = false;
+    }
+}
+
+json replayStatus(Session& s) {
+    json j;
+    j["replaying"] = s.isReplaying;
+    j["speed"] = s.replaySpeed;
+    if (s.isReplaying) {
+        j["tick"] = s.replayPlayer.position();
+        j["length"] = s.replayPlayer.length();
+    }
+    return j;
+}
+
+// ------------------ Simulation ------------------
+// Publishes the session's current state, reusing the previous snapshot's
+// grid and change ticks for anything that did not change. Caller must hold
+// s.mutex.
+void publishSnapshot(Session& s) {
+    auto prev = s.getSnapshot();
+    auto snap = std::make_shared<StateSnapshot>();
+    const Player& player = s.gameState.player;
+    const Level& level = s.gameState.level;
+
+    // An undo or a replay can swap in a different map without a reload;
+    // give it a new version so clients refetch the grid.
+    if (prev && prev->levelVersion == s.levelVersion && prev->levelRevision != level.revision())
+        s.levelVersion = nextLevelVersion++;
+
+    snap->tick = s.tick;
+    snap->levelID = s.currentLevelID;
+    snap->levelVersion = s.levelVersion;
+    snap->levelRevision = level.revision();
+    snap->width = level.getWidth();
+    snap->height = level.getHeight();
+    snap->level = level;
+    snap->player = player;
+
+    snap->tutorial = s.tutorialManager.getCurrentMessage();
+    if (level.isGoal(player.x, player.y))
+        snap->goalMessage = "GOAL REACHED!";
+    if (level.isDoor(player.x, player.y))
+        snap->choices = decisionTree.getOptions();
+
+    if (prev && prev->levelVersion == snap->levelVersion) {
+        snap->grid = prev->grid;
+        snap->packedGrid = prev->packedGrid;
+
+        bool moved = prev->player.x != player.x || prev->player.y != player.y
+            || prev->player.vy != player.vy || prev->player.grounded != player.grounded;
+        snap->playerTick = moved ? snap->tick : prev->playerTick;
+
+        bool messagesChanged = prev->tutorial != snap->tutorial
+            || prev->goalMessage != snap->goalMessage
+            || prev->choices != snap->choices;
+        snap->messageTick = messagesChanged ? snap->tick : prev->messageTick;
+    } else {
+        // A level still identical to its template shares the template's grids.
+        const LevelTemplate& t = levelTemplate(s.currentLevelID);
+        bool pristine = level.revision() == t.level.revision();
+        if (pristine) {
+            snap->grid = t.grid;
+            snap->packedGrid = t.packedGrid;
+        } else if (fitsView(level)) {
+            snap->grid = buildGrid(level, 0, 0, level.getWidth(), level.getHeight());
+            snap->packedGrid = packGrid(level, 0, 0, level.getWidth(), level.getHeight());
+        }
+        snap->playerTick = snap->tick;
+        snap->messageTick = snap->tick;
+    }
 
-    replayManager.record(gameState);
+    s.setSnapshot(std::move(snap));
 }
 
-void replayTick() {
-    if (!isReplaying) return;
-    if (replayBackup.empty()) { isReplaying = false; return; }
-    gameState = replayBackup.front();
-    replayBackup.pop();
+// Fixed-timestep loop: wall time is accumulated and consumed in whole ticks,
+// so the simulation rate is independent of how often clients poll.
+void simulationLoop(int tickRate) {
+    using clock = std::chrono::steady_clock;
+    const auto tickDuration = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(1.0 / tickRate));
+
+    auto previous = clock::now();
+    clock::duration accumulator = clock::duration::zero();
+
+    while (running) {
+        auto now = clock::now();
+        accumulator += now - previous;
+        previous = now;
+
+        if (accumulator >= tickDuration) {
+            int steps = 0;
+            while (accumulator >= tickDuration && steps < MAX_STEPS_PER_FRAME) {
+                accumulator -= tickDuration;
+                steps++;
+            }
+            // Too far behind: drop the backlog instead of spiralling.
+            if (accumulator >= tickDuration) accumulator = clock::duration::zero();
+
+            for (auto& session : sessions.all()) {
+                std::lock_guard<std::mutex> lock(session->mutex);
+                for (int i = 0; i < steps; i++) {
+                    if (session->isReplaying) replayTick(*session);
+                    else if (session->isRewinding) rewindTick(*session);
+                    else physics(*session);
+                    session->tick++;
+                }
+                publishSnapshot(*session);
+            }
+        }
+
+        std::this_thread::sleep_until(previous + (tickDuration - accumulator));
+    }
 }
 
-int main() {
-    loadLevel(1);
+void sweepLoop() {
+    auto nextSweep = std::chrono::steady_clock::now() + SWEEP_INTERVAL;
+    while (running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        if (std::chrono::steady_clock::now() < nextSweep) continue;
+
+        size_t evicted = sessions.evictIdle(SESSION_TTL);
+        if (evicted > 0)
+            std::cout << "Evicted " << evicted << " idle session(s), " << sessions.size() << " live\n";
+        nextSweep += SWEEP_INTERVAL;
+    }
+}
+
+// Looks the caller up by cookie or header, creating a fresh session (and
+// setting its cookie) for unknown clients.
+std::shared_ptr<Session> getSession(const httplib::Request& req, httplib::Response& res) {
+    std::string token = req.get_header_value(SESSION_HEADER);
+    if (token.empty()) token = getCookie(req, SESSION_COOKIE);
+
+    if (!token.empty()) {
+        auto session = sessions.find(token);
+        if (session) return session;
+    }
+
+    auto session = sessions.create(levelTemplate(1).level, token);
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        loadLevel(*session, 1);
+        publishSnapshot(*session);
+    }
+    res.set_header("Set-Cookie", std::string(SESSION_COOKIE) + "=" + token + "; Path=/; HttpOnly; SameSite=Strict");
+    res.set_header(SESSION_HEADER, token);
+    return session;
+}
+
+// User + system CPU time used by this process so far.
+double processCpuSeconds() {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) return -1;
+    auto toSeconds = [](const FILETIME& t) {
+        return (((unsigned long long)t.dwHighDateTime << 32) | t.dwLowDateTime) / 1e7;
+    };
+    return toSeconds(kernel) + toSeconds(user);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+         + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#endif
+}
+
+// Dev mode only: picks up edits to index.html, script.js and assets.
+void watchStaticFiles() {
+    while (running) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        size_t reloaded = staticFiles.reloadChanged();
+        if (reloaded > 0) std::cout << "Reloaded " << reloaded << " static file(s)\n";
+    }
+}
+
+// Usage: server [tickRate] [--dev] [--replays DIR] [--levels DIR] [--threads N]
+int main(int argc, char** argv) {
+    int tickRate = DEFAULT_TICK_RATE;
+    int httpThreads = DEFAULT_HTTP_THREADS;
+    bool devMode = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--dev") devMode = true;
+        else if (arg == "--threads" && i + 1 < argc) httpThreads = std::atoi(argv[++i]);
+        else if (arg == "--replays" && i + 1 < argc) replayDir = argv[++i];
+        else if (arg == "--levels" && i + 1 < argc) levelDir = argv[++i];
+        else tickRate = std::atoi(argv[i]);
+    }
+    if (tickRate <= 0) tickRate = DEFAULT_TICK_RATE;
+    if (httpThreads < 2) httpThreads = DEFAULT_HTTP_THREADS;
+    maxEventStreams = (size_t)httpThreads / 2;
+
+    loadStaticFiles();
+    levelDir = findLevelDir(levelDir, argv[0]);
+    if (!loadLevelTemplates()) {
+        std::cout << "No levels found in " << levelDir << "\n";
+        return 1;
+    }
+    if (!replayDir.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(replayDir, ec);
+    }
+
+    std::thread simThread(simulationLoop, tickRate);
+    std::thread sweepThread(sweepLoop);
+    std::thread watchThread;
+    if (devMode) watchThread = std::thread(watchStaticFiles);
 
     httplib::Server svr;
+    svr.new_task_queue = [httpThreads] { return new httplib::ThreadPool((size_t)httpThreads); };
+
+    // Responses are small and latency-bound; don't let Nagle hold them back.
+    svr.set_tcp_nodelay(true);
 
-    svr.Get("/", [](const httplib::Request&, httplib::Response& res) {
-        std::string html = readFile("index.html");
-        res.set_content(html.empty() ? "<h1>Error: index.html missing</h1>" : html, "text/html");
+    svr.Get("/", [](const httplib::Request& req, httplib::Response& res) {
+        if (!staticFiles.serve("/", req, res))
+            res.set_content("<h1>Error: index.html missing</h1>", "text/html");
     });
 
-    svr.Get("/script.js", [](const httplib::Request&, httplib::Response& res) {
-        std::string js = readFile("script.js");
-        res.set_content(js.empty() ? "console.error('script.js missing');" : js, "application/javascript");
+    svr.Get("/script.js", [](const httplib::Request& req, httplib::Response& res) {
+        if (!staticFiles.serve("/script.js", req, res))
+            res.set_content("console.error('script.js missing');", "application/javascript");
     });
 
-    auto ret = svr.set_mount_point("/assets", "./assets");
-    if (!ret) std::cout << "Warning: 'assets' folder not found.\n";
+    svr.Get("/assets/.*", [](const httplib::Request& req, httplib::Response& res) {
+        if (!staticFiles.serve(req.path, req, res)) res.status = 404;
+    });
 
+    // Accepts a single {"key", "choiceId"} or a batch {"keys": [...]} so the
+    // client can flush every input from one frame in a single request. The
+    // whole body is checked first, so a bad batch changes nothing.
     svr.Post("/input", [](const httplib::Request& req, httplib::Response& res) {
+        auto session = getSession(req, res);
+        std::vector<std::pair<std::string, int>> inputs;
         try {
-            std::lock_guard<std::mutex> lock(gameMutex);
             auto j = json::parse(req.body);
+            auto parse = [&](const json& input) {
+                inputs.emplace_back(input.at("key").get<std::string>(), input.value("choiceId", -1));
+            };
+            if (j.contains("keys")) {
+                if (!j.at("keys").is_array()) throw std::invalid_argument("keys");
+                for (auto& input : j.at("keys")) parse(input);
+            } else {
+                parse(j);
+            }
+        }
+        catch (...) {
+            res.status = 400;
+            return;
+        }
 
-            std::string key = j["key"];
-            int choiceId = -1;
-            if (j.contains("choiceId")) choiceId = j["choiceId"];
+        std::lock_guard<std::mutex> lock(session->mutex);
+        for (auto& input : inputs) handleInput(*session, input.first, input.second);
+        res.set_content("{\"status\":\"ok\"}", "application/json");
+    });
 
-            handleInput(key, choiceId);
-            res.set_content("{\"status\":\"ok\"}", "application/json");
+    // POST /replay/seek?tick=<n> jumps the replay to tick n of the level's
+    // recording, starting a replay if none is playing.
+    svr.Post("/replay/seek", [](const httplib::Request& req, httplib::Response& res) {
+        auto session = getSession(req, res);
+        unsigned long target;
+        try {
+            target = std::stoul(req.get_param_value("tick"));
         }
         catch (...) {
             res.status = 400;
+            return;
         }
+
+        std::lock_guard<std::mutex> lock(session->mutex);
+        if (!session->isReplaying && !startReplay(*session)) {
+            res.status = 409;
+            return;
+        }
+        session->replayPlayer.seek(PHYSICS, (uint32_t)std::min<unsigned long>(target, UINT32_MAX));
+        session->gameState = session->replayPlayer.current();
+        publishSnapshot(*session);
+        res.set_content(replayStatus(*session).dump(), "application/json");
     });
 
-    svr.Get("/state", [](const httplib::Request&, httplib::Response& res) {
-        std::lock_guard<std::mutex> lock(gameMutex);
+    // POST /replay/load?file=<name> plays a run archived in the --replays
+    // directory on the level it was recorded on; live play resumes where it
+    // was once the run ends. Nothing is recorded while it plays. Runs from
+    // another version of the level, or whose start is off the level or
+    // inside a wall, are refused.
+    svr.Post("/replay/load", [](const httplib::Request& req, httplib::Response& res) {
+        auto session = getSession(req, res);
+        std::string name = req.get_param_value("file");
+        if (replayDir.empty() || name.empty() || name[0] == '.' || name.find_first_of("/\\") != std::string::npos) {
+            res.status = 400;
+            return;
+        }
 
-        physics();
-        replayTick();
+        auto file = ReplayFile::open(replayDir + "/" + name, configHash(PHYSICS));
+        if (!file) {
+            res.status = 404;
+            return;
+        }
+        // The level id comes from the file; play only on a level we have.
+        const ReplayFileHeader& h = file->header();
+        auto level = levelTemplates.find((int)h.levelID);
+        if (level == levelTemplates.end() || level->second.levelHash != h.levelHash
+            || h.startX < 0 || h.startX >= level->second.level.getWidth()
+            || h.startY < 0 || h.startY >= level->second.level.getHeight()
+            || level->second.level.isBlocked(h.startX, h.startY)) {
+            res.status = 422;
+            return;
+        }
+        std::lock_guard<std::mutex> lock(session->mutex);
+        Replay replay = replayFromFile(std::move(file), level->second.level);
+        playReplay(*session, std::move(replay), true);
+        publishSnapshot(*session);
+        res.set_content(replayStatus(*session).dump(), "application/json");
+    });
 
-        json j;
+    // POST /replay/speed?rate=<r> sets replay ticks per simulation tick
+    // (0 pauses); it sticks for later replays too.
+    svr.Post("/replay/speed", [](const httplib::Request& req, httplib::Response& res) {
+        auto session = getSession(req, res);
+        double rate;
+        try {
+            rate = std::stod(req.get_param_value("rate"));
+        }
+        catch (...) {
+            res.status = 400;
+            return;
+        }
 
-        j["player"] = { {"x", gameState.player.x}, {"y", gameState.player.y} };
-        j["width"] = WIDTH;
-        j["height"] = HEIGHT;
+        std::lock_guard<std::mutex> lock(session->mutex);
+        session->replayPlayer.setSpeed(rate);
+        session->replaySpeed = session->replayPlayer.getSpeed();
+        res.set_content(replayStatus(*session).dump(), "application/json");
+    });
 
-        j["tutorial"] = tutorialManager.getCurrentMessage();
-        if (gameState.player.x == level.goalX && gameState.player.y == level.goalY) {
-            j["goalMessage"] = "GOAL REACHED!";
-        } else {
-            j["goalMessage"] = "";
+    // Server-sent events: one JSON delta per published snapshot, encoded the
+    // same way as /state relative to the previous event on this stream.
+    // Answers 503 once maxEventStreams are open.
+    svr.Get("/events", [](const httplib::Request& req, httplib::Response& res) {
+        auto session = getSession(req, res);
+        if (openEventStreams.fetch_add(1) >= maxEventStreams) {
+            openEventStreams--;
+            res.status = 503;
+            return;
         }
+        res.set_header("Cache-Control", "no-cache");
+
+        struct Stream {
+            std::shared_ptr<const StateSnapshot> last;
+            long long tick = -1;
+            unsigned long long levelVersion = 0;
+            Camera camera;
+        };
+        auto stream = std::make_shared<Stream>(Stream{ nullptr, -1, 0, requestView(req) });
+
+        res.set_chunked_content_provider("text/event-stream",
+            [session, stream](size_t, httplib::DataSink& sink) {
+                if (!running) return false;
+
+                auto snap = session->waitForSnapshot(stream->last, EVENT_HEARTBEAT);
+                if (snap == stream->last) {
+                    static const std::string ping = ": ping\n\n";
+                    return sink.write(ping.data(), ping.size());
+                }
+
+                session->touch();
+                StateDelta delta = diffState(*snap, stream->tick, stream->levelVersion);
+                placeView(*snap, delta, stream->camera);
+                stream->last = snap;
+                stream->tick = (long long)snap->tick;
+                stream->levelVersion = snap->levelVersion;
+                if (!delta.grid && !delta.player && !delta.messages) return true;
+
+                std::string event = "data: " + encodeState(*snap, delta, stream->camera) + "\n\n";
+                return sink.write(event.data(), event.size());
+            },
+            [](bool) { openEventStreams--; });
+    });
 
-        if (level.isDoor(gameState.player.x, gameState.player.y)) {
-            auto options = decisionTree.getOptions();
-            j["choices"] = json::array();
-            for (auto& opt : options) {
-                j["choices"].push_back({ {"id", opt.first}, {"text", opt.second} });
-            }
+    // GET /state?tick=<last tick>&level=<level version> returns only what
+    // changed since that tick; omit both for a full state. See requestView
+    // for the view parameters.
+    svr.Get("/state", [](const httplib::Request& req, httplib::Response& res) {
+        auto session = getSession(req, res);
+        auto snapshot = session->getSnapshot();
+
+        long long sinceTick = -1;
+        unsigned long long levelVersion = 0;
+        try {
+            if (req.has_param("tick")) sinceTick = std::stoll(req.get_param_value("tick"));
+            if (req.has_param("level")) levelVersion = std::stoull(req.get_param_value("level"));
+        }
+        catch (...) {
+            sinceTick = -1;
         }
 
-        j["grid"] = json::array();
-        for (int y = 0; y < HEIGHT; y++) {
-            std::string row = "";
-            for (int x = 0; x < WIDTH; x++) {
-                if (x == gameState.player.x && y == gameState.player.y) row += "P";
-                else if (x == level.goalX && y == level.goalY) row += "G";
-                else if (level.isDoor(x, y)) row += "D";
-                else row += level.getTile(x, y);
-            }
-            j["grid"].push_back(row);
+        StateDelta delta = diffState(*snapshot, sinceTick, levelVersion);
+        Camera camera = requestView(req);
+        placeView(*snapshot, delta, camera);
+        if (req.get_header_value("Accept").find("application/octet-stream") != std::string::npos) {
+            res.set_content(encodeBinaryState(*snapshot, delta, camera, messageStrings), "application/octet-stream");
+        } else {
+            res.set_content(encodeState(*snapshot, delta, camera), "application/json");
         }
+    });
+
+    // String table for message ids in the binary /state format.
+    svr.Get("/strings", [](const httplib::Request&, httplib::Response& res) {
+        res.set_content(json(messageStrings.all()).dump(), "application/json");
+    });
 
+    svr.Get("/metrics", [](const httplib::Request&, httplib::Response& res) {
+        auto m = sessions.metrics();
+        json j;
+        j["liveSessions"] = m.liveSessions;
+        j["sessionsCreated"] = m.created;
+        j["sessionsEvicted"] = m.evicted;
+        j["lookups"] = m.lookups;
+        j["contendedLookups"] = m.contendedLookups;
+        j["eventStreams"] = openEventStreams.load();
+        j["replayWriteFailures"] = replayDisk.failures();
+
+        // Undo history lost to the save depth cap, rewind history held and
+        // level storage not shared with a template, over live sessions.
+        unsigned long long savesDropped = 0;
+        size_t rewindBytes = 0, levelPrivateBytes = 0;
+        for (auto& session : sessions.all()) {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            savesDropped += session->saveManager.dropped();
+            rewindBytes += session->rewind.memoryUsage();
+            levelPrivateBytes += session->gameState.level.privateBytes(levelTemplate(session->currentLevelID).level);
+        }
+        j["savesDropped"] = savesDropped;
+        j["rewindBytes"] = rewindBytes;
+        j["levelPrivateBytes"] = levelPrivateBytes;
+        j["cpuSeconds"] = processCpuSeconds();
         res.set_content(j.dump(), "application/json");
     });
 
-    std::cout << "Server started at http://localhost:8080\n";
+    std::cout << "Server started at http://localhost:8080 (" << tickRate << " ticks/s)\n";
     svr.listen("0.0.0.0", 8080);
+
+    running = false;
+    simThread.join();
+    sweepThread.join();
+    if (watchThread.joinable()) watchThread.join();
 }
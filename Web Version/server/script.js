@@ -6,8 +6,19 @@ const TILE_SIZE = 30;
 const FPS = 20;
 const FRAME_DELAY = 1000 / FPS;
 
+// The server only sends the tiles in a view this size around the player.
+const VIEW_WIDTH = Math.floor(canvas.width / TILE_SIZE);
+const VIEW_HEIGHT = Math.floor(canvas.height / TILE_SIZE);
+
 let flashTimeout = null;
 
+// Last full state we know of; /state only sends what changed since `tick`.
+let gameState = null;
+
+// Ask for the compact binary /state encoding; set to false to debug with JSON.
+const USE_BINARY_STATE = true;
+let messageStrings = [""];
+
 //asset
 const assets = {};
 const assetNames = ["background", "platform", "player", "goal", "door"];
@@ -45,12 +56,38 @@ function flashMessage(text, color = "#0ff", duration = 800) {
 }
 
 //input
-function sendInput(key, choiceId = -1) {
+// Keys pressed within one frame go to the server as a single batch, and only
+// one batch is in flight at a time so inputs are applied in order.
+let pendingInputs = [];
+let inputInFlight = false;
+let flushScheduled = false;
+
+function flushInputs() {
+  flushScheduled = false;
+  if (inputInFlight || pendingInputs.length === 0) return;
+
+  const keys = pendingInputs;
+  pendingInputs = [];
+  inputInFlight = true;
+
   fetch("/input", {
     method: "POST",
     headers: { "Content-Type": "application/json" },
-    body: JSON.stringify({ key, choiceId }),
-  }).catch((err) => console.error("Input Error:", err));
+    body: JSON.stringify({ keys }),
+  })
+    .catch((err) => console.error("Input Error:", err))
+    .finally(() => {
+      inputInFlight = false;
+      flushInputs();
+    });
+}
+
+function sendInput(key, choiceId = -1) {
+  pendingInputs.push({ key, choiceId });
+  if (!flushScheduled) {
+    flushScheduled = true;
+    requestAnimationFrame(flushInputs);
+  }
 }
 
 document.addEventListener("keydown", (e) => {
@@ -70,6 +107,8 @@ document.addEventListener("keydown", (e) => {
   } else if (e.key.toLowerCase() === "e") {
     sendInput("replay");
     flashMessage("Replay Started!", "#f0f");
+  } else if (e.key.toLowerCase() === "r") {
+    sendInput("rewind");
   } else if (e.key === "1") sendInput("choose", 1);
   else if (e.key === "2") sendInput("choose", 2);
   else if (e.key.toLowerCase() === "q") sendInput("reset");
@@ -82,13 +121,17 @@ function drawGame(data) {
   ctx.fillStyle = "#000";
   ctx.fillRect(0, 0, canvas.width, canvas.height);
 
-  for (let y = 0; y < data.height; y++) {
-    const row = data.grid[y];
+  const view = data.view;
+  for (let vy = 0; vy < view.height; vy++) {
+    const row = data.grid[vy];
+    const y = view.y + vy;
 
-    for (let x = 0; x < data.width; x++) {
-      const char = row[x];
-      const posX = x * TILE_SIZE;
-      const posY = y * TILE_SIZE;
+    for (let vx = 0; vx < view.width; vx++) {
+      const x = view.x + vx;
+      const isPlayer = x === data.player.x && y === data.player.y;
+      const char = isPlayer ? "P" : row[vx];
+      const posX = vx * TILE_SIZE;
+      const posY = vy * TILE_SIZE;
 
       if (char === "#")
         ctx.drawImage(assets["platform"], posX, posY, TILE_SIZE, TILE_SIZE);
@@ -115,35 +158,147 @@ function drawGame(data) {
   }
 }
 
-async function update() {
-  try {
-    const res = await fetch("/state");
-    const data = await res.json();
+//state
+async function lookupString(id) {
+  if (id >= messageStrings.length) {
+    const res = await fetch("/strings");
+    messageStrings = await res.json();
+  }
+  return messageStrings[id] || "";
+}
+
+const TILE_CHARS = [" ", "#", "G", "D"];
+
+// Decodes the little-endian layout documented in BinaryState.h into the same
+// shape as the JSON response.
+async function decodeBinaryState(buffer) {
+  const view = new DataView(buffer);
+  let offset = 0;
+  const u8 = () => view.getUint8(offset++);
+  const u16 = () => { const v = view.getUint16(offset, true); offset += 2; return v; };
+  const u32 = () => { const v = view.getUint32(offset, true); offset += 4; return v; };
+  const i32 = () => { const v = view.getInt32(offset, true); offset += 4; return v; };
+  const f32 = () => { const v = view.getFloat32(offset, true); offset += 4; return v; };
 
-    if (data.goalMessage && data.goalMessage !== "") {
-      messageDiv.textContent = data.goalMessage;
-      messageDiv.style.color = "rgba(255, 0, 0, 1)";
+  const version = u8();
+  if (version !== 2) throw new Error(`Unknown state format ${version}`);
+
+  const flags = u8();
+  const state = {};
+  state.levelId = u16();
+  state.tick = u32();
+  state.level = u32();
+
+  if (flags & 1) {
+    state.player = { x: i32(), y: i32(), vy: f32(), grounded: u8() === 1 };
+  }
+
+  if (flags & 2) {
+    const tutorialId = u16();
+    const goalId = u16();
+    const count = u8();
+    const choiceIds = [];
+    for (let i = 0; i < count; i++) choiceIds.push({ id: u8(), textId: u16() });
+
+    state.tutorial = await lookupString(tutorialId);
+    state.goalMessage = await lookupString(goalId);
+    state.choices = [];
+    for (const c of choiceIds) {
+      state.choices.push({ id: c.id, text: await lookupString(c.textId) });
     }
+  }
 
-    // Tutorial
-    else if (data.tutorial && data.tutorial !== "") {
-      messageDiv.textContent = "TUTORIAL: " + data.tutorial;
-      messageDiv.style.color = "#ff0";
+  if (flags & 4) {
+    state.width = u32();
+    state.height = u32();
+    state.view = { x: u32(), y: u32(), width: u16(), height: u16() };
+    const packed = new Uint8Array(buffer, offset);
+    state.grid = [];
+    for (let y = 0; y < state.view.height; y++) {
+      let row = "";
+      for (let x = 0; x < state.view.width; x++) {
+        const i = y * state.view.width + x;
+        row += TILE_CHARS[(packed[i >> 2] >> ((i & 3) * 2)) & 3];
+      }
+      state.grid.push(row);
     }
+  }
 
-    // Choices
-    else if (data.choices && data.choices.length > 0) {
-      let choiceMsg = "DECISION TIME! Press ";
-      data.choices.forEach((c) => {
-        choiceMsg += `[${c.id}] for ${c.text}   `;
+  return state;
+}
+
+// A full state carries every field; a delta overwrites just the ones it has,
+// including the grid and view when the view moved.
+function mergeState(delta) {
+  if (!gameState) gameState = delta;
+  else Object.assign(gameState, delta);
+}
+
+// Size of the view, and where the one we hold is, for /state and /events.
+function viewParams() {
+  let params = `vw=${VIEW_WIDTH}&vh=${VIEW_HEIGHT}`;
+  if (gameState && gameState.view) params += `&vx=${gameState.view.x}&vy=${gameState.view.y}`;
+  return params;
+}
+
+function render() {
+  const data = gameState;
+  if (!data) return;
+
+  if (data.goalMessage && data.goalMessage !== "") {
+    messageDiv.textContent = data.goalMessage;
+    messageDiv.style.color = "rgba(255, 0, 0, 1)";
+  }
+
+  // Tutorial
+  else if (data.tutorial && data.tutorial !== "") {
+    messageDiv.textContent = "TUTORIAL: " + data.tutorial;
+    messageDiv.style.color = "#ff0";
+  }
+
+  // Choices
+  else if (data.choices && data.choices.length > 0) {
+    let choiceMsg = "DECISION TIME! Press ";
+    data.choices.forEach((c) => {
+      choiceMsg += `[${c.id}] for ${c.text}   `;
+    });
+    messageDiv.textContent = choiceMsg;
+    messageDiv.style.color = "#0ff";
+  } else if (!flashTimeout) {
+    messageDiv.textContent = "";
+  }
+
+  drawGame(data);
+}
+
+// Redraw at most once per animation frame, and only when state arrived.
+let renderScheduled = false;
+
+function scheduleRender() {
+  if (renderScheduled) return;
+  renderScheduled = true;
+  requestAnimationFrame(() => {
+    renderScheduled = false;
+    render();
+  });
+}
+
+// Fallback for browsers without EventSource: poll /state.
+async function update() {
+  try {
+    let url = "/state?" + viewParams();
+    if (gameState) url += `&tick=${gameState.tick}&level=${gameState.level}`;
+
+    if (USE_BINARY_STATE) {
+      const res = await fetch(url, {
+        headers: { Accept: "application/octet-stream" },
       });
-      messageDiv.textContent = choiceMsg;
-      messageDiv.style.color = "#0ff";
-    } else if (!flashTimeout) {
-      messageDiv.textContent = "";
+      mergeState(await decodeBinaryState(await res.arrayBuffer()));
+    } else {
+      const res = await fetch(url);
+      mergeState(await res.json());
     }
-
-    drawGame(data);
+    scheduleRender();
   } catch (err) {
     console.error("Game Loop Error:", err);
   }
@@ -151,4 +306,20 @@ async function update() {
   setTimeout(update, FRAME_DELAY);
 }
 
-update();
+// The server pushes a delta for every tick over /events. After a reconnect
+// the first event carries the full state again.
+function startEvents() {
+  const events = new EventSource("/events?" + viewParams());
+  events.onmessage = (e) => {
+    mergeState(JSON.parse(e.data));
+    scheduleRender();
+  };
+  events.onerror = () => {
+    // A refused stream (the server is at its limit) is not retried; poll.
+    if (events.readyState === EventSource.CLOSED) update();
+    else console.error("Event stream interrupted, reconnecting");
+  };
+}
+
+if (window.EventSource) startEvents();
+else update();
@@ -0,0 +1,303 @@
+// Headless benchmarks for the simulation core and the web server's state
+// encoding. Self-contained: each case is run for at least MIN_TIME and
+// reported as ns/op, heap allocations/op and items/s.
+//
+// Usage: game_bench [max level side]   (default 4096)
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "World.h"
+#include "BatchWorld.h"
+#include "LevelFile.h"
+#include "GameState.h"
+#include "ReplayManager.h"
+#include "StateEncoder.h"
+
+// ------------------ Allocation counting ------------------
+static std::atomic<unsigned long long> allocationCount{0};
+
+// Every form the program uses is replaced, so all memory comes from and
+// returns to malloc. GCC still warns (-Wmismatched-new-delete) wherever it
+// inlines a new/delete pair into malloc/free; that is silenced for this
+// target in CMakeLists.txt.
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+// ------------------ Harness ------------------
+using benchClock = std::chrono::steady_clock;
+const std::chrono::milliseconds MIN_TIME(200);
+
+// Keeps results alive so the optimizer cannot drop the work.
+static volatile uint64_t sink;
+
+// Runs `op` in growing batches until MIN_TIME has passed. `itemsPerOp` is
+// what one call processes (cells, ticks, bytes...) for the throughput column.
+void bench(const std::string& name, double itemsPerOp, const char* itemUnit, const std::function<void()>& op) {
+    op();   // warm-up
+
+    unsigned long long iterations = 0;
+    unsigned long long batch = 1;
+    unsigned long long allocations = 0;
+    benchClock::duration elapsed{0};
+
+    while (elapsed < MIN_TIME) {
+        unsigned long long allocBefore = allocationCount.load();
+        auto start = benchClock::now();
+        for (unsigned long long i = 0; i < batch; i++) op();
+        elapsed += benchClock::now() - start;
+        allocations += allocationCount.load() - allocBefore;
+        iterations += batch;
+        if (batch < (1ULL << 20)) batch *= 2;
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    double allocs = (double)allocations / iterations;
+    double throughput = itemsPerOp * 1e9 / ns;
+    printf("%-36s %12llu %14.1f %10.2f %14.3e %s/s\n", name.c_str(), iterations, ns, allocs, throughput, itemUnit);
+}
+
+// ------------------ Fixtures ------------------
+// A level with ground, walls and a scattering of platforms, deterministic
+// for a given size.
+void buildLevel(Level& level, unsigned seed) {
+    int w = level.getWidth();
+    int h = level.getHeight();
+    std::mt19937 rng(seed);
+    level.resetGrid();
+    level.createFullGround();
+    level.createWalls();
+    for (int y = 3; y < h - 2; y += 3) {
+        for (int x = 0; x < w; x += 16) {
+            if (rng() % 2) level.createPlatform(y, x + (int)(rng() % 8), 4 + (int)(rng() % 8));
+        }
+    }
+    level.addDoor(w / 2, h - 2);
+    level.setGoal(w - 3, 2);
+}
+
+std::string sizeLabel(int w, int h) {
+    return std::to_string(w) + "x" + std::to_string(h);
+}
+
+void benchLevel(int w, int h) {
+    std::string label = sizeLabel(w, h);
+    World world(w, h);
+    buildLevel(world.level, 42);
+
+    // Physics: the player runs and jumps back and forth across the level.
+    world.spawn(w / 2, h - 2);
+    unsigned tick = 0;
+    bench("physics.step " + label, 1, "ticks", [&] {
+        uint8_t inputs = (tick / 64) % 2 ? INPUT_LEFT : INPUT_RIGHT;
+        if (tick % 16 == 0) inputs |= INPUT_JUMP;
+        world.step(inputs);
+        tick++;
+        sink = sink + world.player.y;
+    });
+
+    // Undo snapshot of the whole world, one broken block, then undo: only
+    // the touched band is copied, whatever the level size.
+    bench("World.snapshot+write+restore " + label, 1, "undos", [&] {
+        World::Snapshot saved = world.snapshot();
+        world.level.clearBlock(w / 2, h - 1);
+        world.restore(saved);
+        sink = sink + world.level.revision();
+    });
+
+    // Collision queries at random in-range cells.
+    std::mt19937 rng(7);
+    std::vector<std::pair<int, int>> probes(4096);
+    for (auto& p : probes) p = { (int)(rng() % w), (int)(rng() % h) };
+    bench("Level::isBlocked " + label, (double)probes.size(), "queries", [&] {
+        uint64_t blocked = 0;
+        for (auto& p : probes) blocked += world.level.isBlocked(p.first, p.second);
+        sink = sink + blocked;
+    });
+
+    // Long moves from the same cells: a fall and a dash of up to the whole
+    // level, swept with bit scans, against stepping a cell at a time.
+    bench("Level::sweep " + label, (double)probes.size(), "moves", [&] {
+        int64_t reached = 0;
+        for (auto& p : probes)
+            reached += world.level.sweepY(p.first, p.second, h) + world.level.sweepX(p.first, p.second, w);
+        sink = sink + reached;
+    });
+    bench("Level::isBlocked per cell " + label, (double)probes.size(), "moves", [&] {
+        int64_t reached = 0;
+        for (auto& p : probes) {
+            int x = p.first, y = p.second;
+            while (!world.level.isBlocked(p.first, y + 1)) y++;
+            while (!world.level.isBlocked(x + 1, p.second)) x++;
+            reached += y + x;
+        }
+        sink = sink + reached;
+    });
+
+    double cells = (double)w * h;
+
+    // Level load from a compiled, mapped level file: rows are read in place.
+    LevelSource source;
+    source.level = world.level;
+    source.spawnX = w / 2;
+    source.spawnY = h - 2;
+    std::string levelPath = (std::filesystem::temp_directory_path() / "game_bench.lvb").string();
+    std::string error;
+    auto levelFile = writeLevelFile(levelPath, source, error) ? LevelFile::open(levelPath) : nullptr;
+    if (levelFile) {
+        Level loaded;
+        bench("LevelFile::load " + label, cells, "cells", [&] {
+            levelFile->load(loaded);
+            sink = sink + loaded.revision();
+        });
+    }
+
+    // Whole-level grid serialization, done once per level version on the
+    // server for levels that fit in one view.
+    bench("state.buildGrid " + label, cells, "cells", [&] {
+        sink = sink + buildGrid(world.level, 0, 0, w, h)->size();
+    });
+
+    // Full /state response: snapshot fields plus the spliced grid.
+    StateSnapshot snap;
+    snap.width = w;
+    snap.height = h;
+    snap.level = world.level;
+    snap.player = world.player;
+    snap.tutorial = "Welcome! Press 'right' to move.";
+    snap.grid = buildGrid(world.level, 0, 0, w, h);
+    StateDelta full = diffState(snap, -1, 0);
+    Camera whole(w, h);
+    placeView(snap, full, whole);
+    double bytes = (double)encodeState(snap, full, whole).size();
+    bench("state.encode full " + label, bytes, "bytes", [&] {
+        sink = sink + encodeState(snap, full, whole).size();
+    });
+
+    // Full response for the browser client's 50x20 view, cut from the level.
+    Camera screen(50, 20);
+    placeView(snap, full, screen);
+    double viewBytes = (double)encodeState(snap, full, screen).size();
+    bench("state.encode view " + label, viewBytes, "bytes", [&] {
+        sink = sink + encodeState(snap, full, screen).size();
+    });
+
+    // json::dump of the grid as a parsed document, the pre-snapshot path.
+    nlohmann::json doc;
+    doc["player"] = { {"x", world.player.x}, {"y", world.player.y} };
+    doc["grid"] = nlohmann::json::parse(*snap.grid);
+    double docBytes = (double)doc.dump().size();
+    bench("json::dump " + label, docBytes, "bytes", [&] {
+        sink = sink + doc.dump().size();
+    });
+}
+
+// Input-only replays: one event per input plus a keyframe every
+// REPLAY_KEYFRAME_INTERVAL ticks, re-simulated on playback.
+void benchReplay() {
+    const int frames = 10000;
+    World world(50, 20);
+    buildLevel(world.level, 42);
+
+    GameState start;
+    start.player.x = 25;
+    start.player.y = 18;
+    start.level = world.level;
+    SaveManager saves;
+
+    // Records `frames` ticks the way the server does: inputs, keyframe, physics.
+    auto recordRun = [&](ReplayManager& replay) {
+        GameState state = start;
+        replay.begin(1, 0, state);
+        for (int i = 0; i < frames; i++) {
+            uint8_t inputs = (i / 64) % 2 ? INPUT_LEFT : INPUT_RIGHT;
+            applyInput(state.player, state.level, world.config, inputs);
+            replay.record(i, inputs);
+            replay.keyframe(i, state, saves);
+            stepPhysics(state.player, state.level, world.config);
+        }
+    };
+
+    bench("ReplayManager.record x10000", frames, "frames", [&] {
+        ReplayManager replay;
+        recordRun(replay);
+        sink = sink + replay.copy(frames).eventCount;
+    });
+
+    ReplayManager recorded;
+    recordRun(recorded);
+    bench("ReplayManager.playback x10000", frames, "frames", [&] {
+        ReplayPlayer player(recorded.copy(frames));
+        while (player.step(world.config)) sink = sink + player.current().player.x;
+    });
+
+    std::mt19937 rng(3);
+    ReplayPlayer scrubber(recorded.copy(frames));
+    bench("ReplayPlayer.seek random", 1, "seeks", [&] {
+        scrubber.seek(world.config, rng() % frames);
+        sink = sink + scrubber.current().player.x;
+    });
+}
+
+// Batch stepping: many players on one level, one thread and then all of them.
+void benchBatch() {
+    const size_t lanes = 65536;
+    Level level(256, 256);
+    buildLevel(level, 42);
+
+    // Each lane runs and jumps on its own schedule from its own column.
+    std::vector<std::vector<uint8_t>> schedule(64, std::vector<uint8_t>(lanes));
+    std::mt19937 rng(11);
+    for (auto& inputs : schedule)
+        for (uint8_t& in : inputs) in = (uint8_t)(rng() % 8);
+
+    // 0 is one thread per hardware thread; on a single core that would only
+    // repeat the first run.
+    unsigned threadCounts[] = { 1, 0 };
+    for (unsigned threads : threadCounts) {
+        if (threads == 0 && std::thread::hardware_concurrency() <= 1) continue;
+        BatchWorld batch(level, lanes, threads);
+        for (size_t i = 0; i < lanes; i++) batch.spawn(i, 1 + (int)(i % 254), 254);
+        unsigned tick = 0;
+        std::string name = "BatchWorld.stepAll x65536 " + std::to_string(batch.threads()) + "t";
+        bench(name, (double)lanes, "player-ticks", [&] {
+            batch.stepAll(schedule[tick++ % schedule.size()]);
+            sink = sink + batch.player(tick % lanes).y;
+        });
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxSide = argc > 1 ? std::atoi(argv[1]) : 4096;
+
+    printf("%-36s %12s %14s %10s %14s\n", "benchmark", "iterations", "ns/op", "allocs/op", "throughput");
+
+    const int sizes[][2] = { {50, 20}, {256, 256}, {1024, 1024}, {4096, 4096} };
+    for (auto& size : sizes) {
+        if (size[0] > maxSide || size[1] > maxSide) continue;
+        benchLevel(size[0], size[1]);
+    }
+    benchReplay();
+    benchBatch();
+    return 0;
+}
@@ -2,30 +2,20 @@
 #include <vector>
 #include <conio.h>
 #include <windows.h>
-#include <cmath>
+#include "World.h"
 
 using namespace std;
 
-struct Player {
-    int x, y;
-    double vy;
-    bool grounded;
-};
-
 class Game {
 private:
-    vector<vector<char>> level;
-    Player player;
-    int width, height;
-    const double GRAVITY = 0.4;
-    const double JUMP = -2.0;
-    const double MAX_FALL = 2.0;
+    int width = 60;
+    int height = 20;
+    World world{width, height};
+    Player& player = world.player;
     HANDLE hConsole;
 
 public:
     Game() {
-        width = 60;
-        height = 20;
         hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
         
         // Set buffer size to match window
@@ -48,39 +38,26 @@ public:
     }
 
     void initLevel() {
-        level = vector<vector<char>>(height, vector<char>(width, ' '));
-        
+        Level& level = world.level;
+
         // Ground
-        for (int i = 0; i < width; i++) {
-            level[height-1][i] = '#';
-        }
-        
+        level.createFullGround();
+
         // Platforms - spaced out vertically
-        for (int i = 10; i < 20; i++) level[14][i] = '#';
-        for (int i = 23; i < 35; i++) level[11][i] = '#';
-        for (int i = 37; i < 50; i++) level[8][i] = '#';
-        for (int i = 29; i < 33; i++) level[7][i] = '#';
-        for (int i = 15; i < 25; i++) level[5][i] = '#';
-        
+        level.createPlatform(14, 10, 10);
+        level.createPlatform(11, 23, 12);
+        level.createPlatform(8, 37, 13);
+        level.createPlatform(7, 29, 4);
+        level.createPlatform(5, 15, 10);
+
         // Small step platforms on left
-        for (int i = 5; i < 10; i++) level[17][i] = '#';
-        
+        level.createPlatform(17, 5, 5);
+
         // Walls
-        for (int i = 0; i < height; i++) {
-            level[i][0] = '#';
-            level[i][width-1] = '#';
-        }
-        
-        // Player start - on the ground
-        player.x = 5;
-        player.y = height - 2;
-        player.vy = 0;  
-        player.grounded = true;
-    }
+        level.createWalls();
 
-    bool isBlocked(int x, int y) {
-        if (y < 0 || y >= height || x < 0 || x >= width) return true;
-        return level[y][x] == '#';
+        // Player start - on the ground
+        world.spawn(5, height - 2);
     }
 
     void input() {
@@ -91,23 +68,16 @@ public:
             if (key == -32 || key == 0) {
                 key = _getch();
                 if (key == 75) { // Left
-                    if (!isBlocked(player.x - 1, player.y)) {
-                        player.x--;
-                    }
+                    applyInput(player, world.level, world.config, INPUT_LEFT);
                 }
                 if (key == 77) { // Right
-                    if (!isBlocked(player.x + 1, player.y)) {
-                        player.x++;
-                    }
+                    applyInput(player, world.level, world.config, INPUT_RIGHT);
                 }
             }
             
             // Space to jump
             if (key == 72) {
-                if (player.grounded) {
-                    player.vy = JUMP;
-                    player.grounded = false;
-                }
+                applyInput(player, world.level, world.config, INPUT_JUMP);
             }
             
             // ESC to exit
@@ -118,39 +88,7 @@ public:
     }
 
     void physics() {
-        // Only apply gravity if not grounded
-        if (!player.grounded) {
-            player.vy += GRAVITY;
-            if (player.vy > MAX_FALL) player.vy = MAX_FALL;
-        }
-        
-        // Apply vertical velocity
-        if (player.vy != 0) {
-            int steps = (int)(fabs(player.vy) + 0.5);
-            int dir = (player.vy > 0) ? 1 : -1;
-            
-            for (int i = 0; i < steps; i++) {
-                int newY = player.y + dir;
-                
-                if (isBlocked(player.x, newY)) {
-                    player.vy = 0;
-                    if (dir > 0) {
-                        player.grounded = true;
-                    }
-                    break;
-                } else {
-                    player.y = newY;
-                }
-            }
-        }
-        
-        // Check if standing on ground
-        if (isBlocked(player.x, player.y + 1)) {
-            player.grounded = true;
-            player.vy = 0;
-        } else {
-            player.grounded = false;
-        }
+        stepPhysics(player, world.level, world.config);
     }
 
     void goalReached(){
@@ -179,7 +117,7 @@ public:
             for (int x = 0; x < width; x++) {
                 if (x == player.x && y == player.y) {
                     output += '@';
-                } else if (level[y][x] == '#') {
+                } else if (world.level.isBlocked(x, y)) {
                     output += '#';
                 } else {
                     output += ' ';
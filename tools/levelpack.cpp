@@ -0,0 +1,125 @@
+// Level pack compiler. Validates every level source (.lvl) in a directory
+// and compiles each to the mapped binary form (.lvb) the games load; see
+// Core/LevelSource.h for the text format and Core/LevelFile.h for the
+// binary one. Each compiled file is read back and checked against its
+// source. Exits non-zero if any level fails.
+//
+// Usage: game_levelpack DIR [--out DIR] [--check]
+//   --check   validate only, write nothing
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "LevelFile.h"
+
+namespace fs = std::filesystem;
+
+struct Options {
+    std::string sourceDir;
+    std::string outDir;
+    bool checkOnly = false;
+};
+
+bool parseOptions(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) opt.outDir = argv[++i];
+        else if (arg == "--check") opt.checkOnly = true;
+        else if (opt.sourceDir.empty() && arg[0] != '-') opt.sourceDir = arg;
+        else return false;
+    }
+    if (opt.sourceDir.empty()) return false;
+    if (opt.outDir.empty()) opt.outDir = opt.sourceDir;
+    return true;
+}
+
+// Same map, spawn and entities as the source it was compiled from.
+bool matchesSource(const LevelFile& file, const LevelSource& source) {
+    const LevelFileHeader& h = file.header();
+    if (h.spawnX != source.spawnX || h.spawnY != source.spawnY) return false;
+
+    Level loaded;
+    file.load(loaded);
+    const Level& expected = source.level;
+    if (loaded.getWidth() != expected.getWidth() || loaded.getHeight() != expected.getHeight()
+        || loaded.goalX != expected.goalX || loaded.goalY != expected.goalY
+        || loaded.entities().size() != expected.entities().size())
+        return false;
+
+    for (int y = -1; y <= expected.getHeight(); y++) {
+        for (int x = -1; x <= expected.getWidth(); x++) {
+            if (loaded.getTile(x, y) != expected.getTile(x, y)) return false;
+            if (loaded.isBlocked(x, y) != expected.isBlocked(x, y)) return false;
+            if (loaded.sweepY(x, y, 1) != expected.sweepY(x, y, 1)) return false;
+            if (loaded.isDoor(x, y) != expected.isDoor(x, y)) return false;
+            if (loaded.isGoal(x, y) != expected.isGoal(x, y)) return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        fprintf(stderr, "usage: %s DIR [--out DIR] [--check]\n", argv[0]);
+        return 1;
+    }
+
+    std::error_code ec;
+    std::vector<fs::path> sources;
+    for (fs::directory_iterator it(opt.sourceDir, ec), end; !ec && it != end; it.increment(ec))
+        if (it->path().extension() == ".lvl") sources.push_back(it->path());
+    if (ec) {
+        fprintf(stderr, "cannot read %s\n", opt.sourceDir.c_str());
+        return 1;
+    }
+    std::sort(sources.begin(), sources.end());
+    if (!opt.checkOnly) fs::create_directories(opt.outDir, ec);
+
+    int failures = 0;
+    for (const fs::path& path : sources) {
+        std::string name = path.filename().string();
+        std::string stem = path.stem().string();
+        if (stem.empty() || stem.find_first_not_of("0123456789") != std::string::npos)
+            printf("%-12s warning: games only load levels named by number (1.lvl, 2.lvl...)\n", name.c_str());
+
+        std::ifstream in(path);
+        LevelSource source;
+        std::string error;
+        if (!in) error = "cannot read";
+        if (!in || !parseLevelSource(in, source, error)) {
+            printf("%-12s FAILED %s\n", name.c_str(), error.c_str());
+            failures++;
+            continue;
+        }
+
+        std::string detail = std::to_string(source.level.getWidth()) + "x" + std::to_string(source.level.getHeight())
+            + ", " + std::to_string(source.level.entities().size()) + " entities";
+        if (opt.checkOnly) {
+            printf("%-12s ok     %s\n", name.c_str(), detail.c_str());
+            continue;
+        }
+
+        std::string output = (fs::path(opt.outDir) / (stem + ".lvb")).string();
+        if (!writeLevelFile(output, source, error)) {
+            printf("%-12s FAILED %s\n", name.c_str(), error.c_str());
+            failures++;
+            continue;
+        }
+        auto compiled = LevelFile::open(output);
+        if (!compiled || !matchesSource(*compiled, source)) {
+            printf("%-12s FAILED %s does not read back as its source\n", name.c_str(), output.c_str());
+            failures++;
+            continue;
+        }
+        printf("%-12s ok     %s, %zu bytes -> %s\n", name.c_str(), detail.c_str(),
+               (size_t)fs::file_size(output, ec), output.c_str());
+    }
+
+    printf("%zu levels, %d failed\n", sources.size(), failures);
+    return failures ? 1 : 0;
+}
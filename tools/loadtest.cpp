@@ -0,0 +1,236 @@
+// HTTP load generator for the game server. Each simulated player gets its
+// own session and keep-alive connection, polls /state at a fixed rate and
+// replays a scripted input sequence.
+//
+// Usage: game_loadtest [--host H] [--port P] [--players N] [--duration S]
+//                      [--poll-hz R] [--input-hz R] [--binary] [--csv]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "httplib.h"
+#include "json.hpp"
+
+using json = nlohmann::json;
+using loadClock = std::chrono::steady_clock;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int players = 50;
+    double duration = 10;
+    double pollHz = 20;
+    double inputHz = 4;
+    bool binary = false;
+    bool csv = false;
+};
+
+// Per-player results, merged once every player has finished.
+struct PlayerStats {
+    std::vector<double> latenciesMs;
+    unsigned long long requests = 0;
+    unsigned long long errors = 0;
+};
+
+const char* INPUT_SCRIPT[] = { "right", "right", "up", "right", "left", "left", "up", "left" };
+const int INPUT_SCRIPT_LENGTH = sizeof(INPUT_SCRIPT) / sizeof(INPUT_SCRIPT[0]);
+
+bool parseOptions(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--host" && hasValue) opt.host = argv[++i];
+        else if (arg == "--port" && hasValue) opt.port = std::atoi(argv[++i]);
+        else if (arg == "--players" && hasValue) opt.players = std::atoi(argv[++i]);
+        else if (arg == "--duration" && hasValue) opt.duration = std::atof(argv[++i]);
+        else if (arg == "--poll-hz" && hasValue) opt.pollHz = std::atof(argv[++i]);
+        else if (arg == "--input-hz" && hasValue) opt.inputHz = std::atof(argv[++i]);
+        else if (arg == "--binary") opt.binary = true;
+        else if (arg == "--csv") opt.csv = true;
+        else return false;
+    }
+    return opt.players > 0 && opt.duration > 0 && opt.pollHz > 0;
+}
+
+// Server CPU seconds as reported by /metrics, or -1 if unavailable.
+double serverCpuSeconds(const Options& opt) {
+    httplib::Client client(opt.host, opt.port);
+    auto res = client.Get("/metrics");
+    if (!res || res->status != 200) return -1;
+    try {
+        return json::parse(res->body).value("cpuSeconds", -1.0);
+    }
+    catch (...) {
+        return -1;
+    }
+}
+
+// Little-endian field at `offset` of a binary /state body.
+uint32_t readU32(const std::string& body, size_t offset) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; i--) v = (v << 8) | (uint8_t)body[offset + i];
+    return v;
+}
+
+// The fields a poll echoes back, from the binary /state format (see
+// BinaryState.h, version 2). Bodies in any other format are ignored.
+void readBinaryState(const std::string& body, long long& tick, unsigned long long& level, int& viewX, int& viewY) {
+    const uint8_t PLAYER = 1, MESSAGES = 2, GRID = 4;
+    if (body.size() < 12 || (uint8_t)body[0] != 2) return;
+    uint8_t flags = (uint8_t)body[1];
+    tick = readU32(body, 4);
+    level = readU32(body, 8);
+
+    size_t offset = 12;
+    if (flags & PLAYER) offset += 13;
+    if (flags & MESSAGES) {
+        if (body.size() < offset + 5) return;
+        offset += 5 + 3 * (uint8_t)body[offset + 4];
+    }
+    if ((flags & GRID) && body.size() >= offset + 16) {
+        viewX = (int)readU32(body, offset + 8);
+        viewY = (int)readU32(body, offset + 12);
+    }
+}
+
+void runPlayer(const Options& opt, int index, loadClock::time_point end, PlayerStats& stats) {
+    httplib::Client client(opt.host, opt.port);
+    client.set_keep_alive(true);
+    client.set_tcp_nodelay(true);
+    client.set_read_timeout(5, 0);
+
+    auto timed = [&](auto&& request) {
+        auto start = loadClock::now();
+        auto res = request();
+        stats.latenciesMs.push_back(std::chrono::duration<double, std::milli>(loadClock::now() - start).count());
+        stats.requests++;
+        if (!res || res->status != 200) stats.errors++;
+        return res;
+    };
+
+    // The first request creates the session; echo its id back as a header.
+    httplib::Headers headers;
+    auto first = timed([&] { return client.Get("/state"); });
+    if (!first) return;
+    headers.emplace("X-Session-Id", first->get_header_value("X-Session-Id"));
+    if (opt.binary) headers.emplace("Accept", "application/octet-stream");
+
+    // Polls carry the browser client's view, and where the server last put it.
+    long long tick = -1;
+    unsigned long long level = 0;
+    int viewX = 0, viewY = 0;
+    auto readState = [&](const std::string& body) {
+        if (opt.binary) {
+            readBinaryState(body, tick, level, viewX, viewY);
+            return;
+        }
+        try {
+            auto j = json::parse(body);
+            tick = j.value("tick", tick);
+            level = j.value("level", level);
+            if (j.contains("view")) {
+                viewX = j["view"].value("x", viewX);
+                viewY = j["view"].value("y", viewY);
+            }
+        }
+        catch (...) {}
+    };
+    readState(first->body);
+
+    const auto pollInterval = std::chrono::duration_cast<loadClock::duration>(std::chrono::duration<double>(1.0 / opt.pollHz));
+    const auto inputInterval = opt.inputHz > 0
+        ? std::chrono::duration_cast<loadClock::duration>(std::chrono::duration<double>(1.0 / opt.inputHz))
+        : loadClock::duration::max();
+
+    // Stagger players so they do not all poll in lock-step.
+    auto nextPoll = loadClock::now() + pollInterval * index / opt.players;
+    auto nextInput = nextPoll;
+    int scriptPos = index % INPUT_SCRIPT_LENGTH;
+
+    while (true) {
+        auto next = std::min(nextPoll, nextInput);
+        if (next >= end) break;
+        std::this_thread::sleep_until(next);
+
+        if (nextInput <= nextPoll) {
+            json body = { {"key", INPUT_SCRIPT[scriptPos]} };
+            scriptPos = (scriptPos + 1) % INPUT_SCRIPT_LENGTH;
+            timed([&] { return client.Post("/input", headers, body.dump(), "application/json"); });
+            nextInput += inputInterval;
+            continue;
+        }
+
+        std::string path = "/state?vw=50&vh=20&vx=" + std::to_string(viewX) + "&vy=" + std::to_string(viewY);
+        if (tick >= 0) path += "&tick=" + std::to_string(tick) + "&level=" + std::to_string(level);
+        auto res = timed([&] { return client.Get(path, headers); });
+        if (res && res->status == 200) readState(res->body);
+        nextPoll += pollInterval;
+    }
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = (size_t)(p * (sorted.size() - 1));
+    return sorted[index];
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        fprintf(stderr, "usage: %s [--host H] [--port P] [--players N] [--duration S] "
+                        "[--poll-hz R] [--input-hz R] [--binary] [--csv]\n", argv[0]);
+        return 1;
+    }
+
+    double cpuBefore = serverCpuSeconds(opt);
+    auto start = loadClock::now();
+    auto end = start + std::chrono::duration_cast<loadClock::duration>(std::chrono::duration<double>(opt.duration));
+
+    std::vector<PlayerStats> stats(opt.players);
+    std::vector<std::thread> players;
+    for (int i = 0; i < opt.players; i++)
+        players.emplace_back(runPlayer, std::cref(opt), i, end, std::ref(stats[i]));
+    for (auto& t : players) t.join();
+
+    double wall = std::chrono::duration<double>(loadClock::now() - start).count();
+    double cpuAfter = serverCpuSeconds(opt);
+
+    std::vector<double> latencies;
+    unsigned long long requests = 0, errors = 0;
+    for (auto& s : stats) {
+        latencies.insert(latencies.end(), s.latenciesMs.begin(), s.latenciesMs.end());
+        requests += s.requests;
+        errors += s.errors;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    double rps = requests / wall;
+    double errorRate = requests ? (double)errors / requests : 0;
+    double cpuPercent = cpuBefore >= 0 && cpuAfter >= 0 ? 100.0 * (cpuAfter - cpuBefore) / wall : -1;
+
+    if (opt.csv) {
+        printf("players,requests,rps,error_rate,p50_ms,p99_ms,p999_ms,server_cpu_pct\n");
+        printf("%d,%llu,%.1f,%.5f,%.3f,%.3f,%.3f,%.1f\n", opt.players, requests, rps, errorRate,
+               percentile(latencies, 0.5), percentile(latencies, 0.99), percentile(latencies, 0.999), cpuPercent);
+        return 0;
+    }
+
+    printf("players:      %d\n", opt.players);
+    printf("duration:     %.1f s\n", wall);
+    printf("requests:     %llu (%.1f req/s)\n", requests, rps);
+    printf("errors:       %llu (%.3f%%)\n", errors, errorRate * 100);
+    printf("latency p50:  %.3f ms\n", percentile(latencies, 0.5));
+    printf("latency p99:  %.3f ms\n", percentile(latencies, 0.99));
+    printf("latency p999: %.3f ms\n", percentile(latencies, 0.999));
+    if (cpuPercent >= 0) printf("server CPU:   %.1f%%\n", cpuPercent);
+    else printf("server CPU:   unavailable\n");
+    return 0;
+}